@@ -0,0 +1,288 @@
+#pragma once
+
+/**
+ End-to-end throughput of the granular engine, built around the process_grain path of the granular example:
+ interpolated read from a source buffer, half-cosine envelope, and multiply-add to the output block.
+
+ Sweeps the number of simultaneous grains, grain length, block size, interpolation order and channel count.
+ Every configuration keeps a constant number of grains alive by respawning finished ones, and measures
+ the processing time of each block against the real-time deadline of the block at 48 kHz.
+
+ Reported per configuration:
+    - p50 and p99 block time
+    - max sustainable voices, extrapolated from the p99 block time per voice at 100% of the deadline
+    - grains finished per CPU second
+    - cache misses per grain per block, if perf counters are available (Linux)
+    - high water mark of the scratch arena holding the temporary buffers of a grain
+
+ Results are written as JSON to the first argument, default granular_benchmark.json.
+ */
+
+#define PURO_USE_PROFILE 0
+
+#if defined(__linux__) && !defined(PURO_PROFILE_USE_PERF)
+    #define PURO_PROFILE_USE_PERF 1
+#endif
+
+#include "../src/puro.hpp"
+#include "../src/profiling.hpp"
+
+#include <fstream>
+
+namespace granular_benchmark {
+
+constexpr double sample_rate = 48000.0;
+constexpr int source_length = 1 << 20;
+constexpr int samples_per_config = 1 << 14;
+
+struct Grain
+{
+    puro::relative_alignment alignment;
+    float read_position;
+    float read_increment;
+    float envelope_position;
+    float envelope_increment;
+};
+
+/** Temporary buffers used by process_grain, handed out by an arena that is reset for every grain */
+struct Context
+{
+    Context (int capacity) : arena(capacity) {}
+
+    puro::scratch_arena<float> arena;
+};
+
+template <int NumChannels, int InterpOrder, typename BufferType, typename SourceType>
+bool process_grain (BufferType dst, Grain& grain, SourceType source, Context& context)
+{
+    std::tie(dst, grain.alignment) = puro::alignment_advance_and_crop_buffer(dst, grain.alignment);
+
+    if (dst.length() > 0)
+    {
+        puro::buffer<NumChannels> audio (dst.length(), context.arena);
+
+        if (InterpOrder == 3)
+            grain.read_position = puro::interp3_fill(audio, source, grain.read_position, grain.read_increment);
+        else
+            grain.read_position = puro::interp1_fill(audio, source, grain.read_position, grain.read_increment);
+
+        puro::buffer<1> envelope (dst.length(), context.arena);
+        grain.envelope_position = puro::envelope_halfcos_fill(envelope, grain.envelope_position, grain.envelope_increment);
+
+        puro::multiply_add(dst, audio, envelope);
+    }
+
+    return grain.alignment.remaining <= 0;
+}
+
+struct config
+{
+    int num_grains;
+    int grain_length;
+    int block_size;
+    int interp_order;
+    int num_channels;
+};
+
+struct result
+{
+    config c;
+    puro::xrun_detector::summary timing;
+    double max_voices;
+    double grains_per_second;
+    double cache_misses_per_grain_block;
+    size_t scratch_bytes;
+};
+
+template <int NumChannels, int InterpOrder>
+result run (const config& c, puro::buffer<NumChannels> source)
+{
+    std::mt19937 gen (1234);
+    std::uniform_real_distribution<float> rate_dist (0.5f, 2.0f);
+    std::uniform_int_distribution<int> position_dist (2, source_length - 3 * c.grain_length);
+    std::uniform_int_distribution<int> elapsed_dist (0, c.grain_length - 1);
+
+    // grains start with the given number of samples already played
+    auto spawn = [&](Grain& g, int elapsed)
+    {
+        g.alignment = { 0, c.grain_length - elapsed };
+        g.read_position = static_cast<float> (position_dist(gen));
+        g.read_increment = rate_dist(gen);
+        g.envelope_increment = puro::envelope_halfcos_get_increment<float>(c.grain_length);
+        g.envelope_position = g.envelope_increment * (elapsed + 1);
+    };
+
+    // all grains are active from the first block, spread over their lifetime so they don't end on the same block
+    std::vector<Grain> grains (c.num_grains);
+    for (auto& g : grains)
+        spawn(g, elapsed_dist(gen));
+
+    std::vector<float> output_data;
+    puro::buffer<NumChannels> output (c.block_size, output_data);
+
+    // audio and envelope, with room to align each channel
+    Context context ((NumChannels + 1) * (c.block_size + 4));
+
+    puro::xrun_detector detector (c.block_size, sample_rate);
+
+#if PURO_PROFILE_USE_PERF
+    PerfCounters perf;
+    uint64_t cache_misses = 0;
+#endif
+
+    const int num_blocks = puro::math::max(16, samples_per_config / c.block_size);
+    int64_t num_finished = 0;
+    double total_micros = 0;
+
+    for (int block = -1; block < num_blocks; ++block) // first block is warm-up
+    {
+        output.clear();
+
+#if PURO_PROFILE_USE_PERF
+        const auto counters_start = perf.read_values();
+#endif
+        const auto t0 = std::chrono::steady_clock::now();
+
+        // grain tails decay towards silence, the engine flushes denormals for the whole block
+        puro::denormal_guard guard;
+
+        int finished_this_block = 0;
+        for (auto& g : grains)
+        {
+            context.arena.reset();
+
+            if (process_grain<NumChannels, InterpOrder>(output, g, source, context))
+            {
+                spawn(g, 0);
+                ++finished_this_block;
+            }
+        }
+
+        const auto t1 = std::chrono::steady_clock::now();
+
+#if PURO_PROFILE_USE_PERF
+        const auto counters = PerfCounters::difference(counters_start, perf.read_values());
+#endif
+
+        if (block < 0)
+            continue;
+
+        detector.record(t0, t1);
+        total_micros += std::chrono::duration<double, std::micro> (t1 - t0).count();
+        num_finished += finished_this_block;
+
+#if PURO_PROFILE_USE_PERF
+        cache_misses += counters.v[PerfCounters::cache_misses];
+#endif
+    }
+
+    result r;
+    r.c = c;
+    r.timing = detector.get_summary();
+    r.max_voices = static_cast<double> (c.num_grains) * r.timing.deadline / static_cast<double> (puro::math::max<uint64_t>(r.timing.p99, 1));
+    r.grains_per_second = static_cast<double> (num_finished) / (total_micros * 1e-6);
+    r.scratch_bytes = context.arena.high_water_mark();
+
+#if PURO_PROFILE_USE_PERF
+    r.cache_misses_per_grain_block = static_cast<double> (cache_misses) / (static_cast<double> (num_blocks) * c.num_grains);
+#else
+    r.cache_misses_per_grain_block = -1;
+#endif
+
+    return r;
+}
+
+template <int NumChannels>
+result run_with_channels (const config& c)
+{
+    static std::vector<float> source_data;
+    puro::buffer<NumChannels> source (source_length, source_data);
+    puro::noise(source);
+
+    return (c.interp_order == 3) ? run<NumChannels, 3>(c, source) : run<NumChannels, 1>(c, source);
+}
+
+result run_config (const config& c)
+{
+    switch (c.num_channels)
+    {
+        case 1: return run_with_channels<1>(c);
+        case 2: return run_with_channels<2>(c);
+        default: return run_with_channels<8>(c);
+    }
+}
+
+void write_json (const char* path, const std::vector<result>& results)
+{
+    std::ofstream file (path);
+    file << "{\"sample_rate\":" << sample_rate << ",\"results\":[\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const result& r = results[i];
+        file << "{\"grains\":" << r.c.num_grains
+             << ",\"grain_length\":" << r.c.grain_length
+             << ",\"block_size\":" << r.c.block_size
+             << ",\"interp_order\":" << r.c.interp_order
+             << ",\"channels\":" << r.c.num_channels
+             << ",\"deadline_ns\":" << r.timing.deadline
+             << ",\"p50_ns\":" << r.timing.p50
+             << ",\"p99_ns\":" << r.timing.p99
+             << ",\"max_ns\":" << r.timing.max
+             << ",\"deadline_misses\":" << r.timing.num_misses
+             << ",\"max_voices\":" << r.max_voices
+             << ",\"grains_per_second\":" << r.grains_per_second
+             << ",\"cache_misses_per_grain_block\":" << r.cache_misses_per_grain_block
+             << ",\"scratch_bytes\":" << r.scratch_bytes
+             << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    file << "]}\n";
+}
+
+} // namespace granular_benchmark
+
+int main (int argc, char* argv[])
+{
+    using namespace granular_benchmark;
+
+    const char* json_path = (argc > 1) ? argv[1] : "granular_benchmark.json";
+
+    const int grain_counts [] = { 16, 64, 256, 1024 };
+    const int grain_lengths [] = { 256, 2048, 16384 };
+    const int block_sizes [] = { 32, 128, 512 };
+    const int interp_orders [] = { 1, 3 };
+    const int channel_counts [] = { 1, 2, 8 };
+
+    std::vector<result> results;
+
+    std::cout << std::setw(7) << "grains" << std::setw(8) << "length" << std::setw(7) << "block"
+              << std::setw(7) << "interp" << std::setw(4) << "ch"
+              << std::setw(11) << "p50 us" << std::setw(11) << "p99 us" << std::setw(11) << "misses"
+              << std::setw(12) << "max voices" << std::setw(14) << "grains/s" << std::setw(16) << "cache miss/gb" << "\n";
+
+    for (int num_channels : channel_counts)
+    for (int interp_order : interp_orders)
+    for (int block_size : block_sizes)
+    for (int grain_length : grain_lengths)
+    for (int num_grains : grain_counts)
+    {
+        const config c = { num_grains, grain_length, block_size, interp_order, num_channels };
+        const result r = run_config(c);
+        results.push_back(r);
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(7) << num_grains << std::setw(8) << grain_length << std::setw(7) << block_size
+                  << std::setw(7) << interp_order << std::setw(4) << num_channels
+                  << std::setw(11) << r.timing.p50 / 1000.0 << std::setw(11) << r.timing.p99 / 1000.0
+                  << std::setw(11) << r.timing.num_misses
+                  << std::setw(12) << std::setprecision(0) << r.max_voices
+                  << std::setw(14) << r.grains_per_second
+                  << std::setw(16) << std::setprecision(2) << r.cache_misses_per_grain_block << "\n";
+    }
+
+    write_json(json_path, results);
+    std::cout << "Wrote " << results.size() << " results to " << json_path << "\n";
+
+    return 0;
+}
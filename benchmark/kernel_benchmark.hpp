@@ -0,0 +1,287 @@
+#pragma once
+
+/**
+ Throughput of the math:: kernels and the buffer_operations templates.
+
+ Every kernel is run over buffer lengths 8..65536, with 1, 2 and 8 channels for the buffer operations,
+ both from 64-byte aligned memory and from memory offset by one sample. The destination is refilled
+ before each call outside of the timed region, and the fastest call out of many is reported, i.e. the
+ numbers are warm-cache best cases.
+
+ Results are printed as a table and written as JSON (first argument, default kernel_benchmark.json),
+ so that runs of different releases can be compared. Cycles are TSC reference cycles.
+ */
+
+#define PURO_USE_PROFILE 0
+
+#include "../src/puro.hpp"
+#include "../src/profiling.hpp"
+
+#include <fstream>
+#include <string>
+
+namespace kernel_benchmark {
+
+constexpr int max_length = 65536;
+constexpr int max_channels = 8;
+constexpr int num_operands = 3;
+constexpr int min_reps = 16;
+constexpr int samples_per_config = 1 << 18;
+
+/** Aligned storage for three multichannel operands, plus a pristine copy to refill the destination from */
+struct operands
+{
+    operands()
+    {
+        const int n = num_operands * max_channels * stride;
+        memory = alloc.allocate(n);
+        pristine = alloc.allocate(n);
+
+        std::mt19937 gen (1234);
+        std::uniform_real_distribution<float> dist (0.5f, 1.5f);
+        for (int i = 0; i < n; ++i)
+            pristine[i] = dist(gen);
+
+        std::copy(pristine, pristine + n, memory);
+    }
+
+    ~operands()
+    {
+        const int n = num_operands * max_channels * stride;
+        alloc.deallocate(memory, n);
+        alloc.deallocate(pristine, n);
+    }
+
+    float* ptr (int operand, int ch, int offset)
+    {
+        return &memory[(operand * max_channels + ch) * stride + offset];
+    }
+
+    puro::dynamic_buffer<max_channels> get (int operand, int num_channels, int length, int offset)
+    {
+        puro::dynamic_buffer<max_channels> buf (num_channels, length);
+        for (int ch = 0; ch < num_channels; ++ch)
+            buf.ptrs[ch] = ptr(operand, ch, offset);
+        return buf;
+    }
+
+    void refill_destination (int num_channels, int length)
+    {
+        for (int ch = 0; ch < num_channels; ++ch)
+            std::copy(&pristine[ch * stride], &pristine[ch * stride + length + 1], &memory[ch * stride]);
+    }
+
+    static constexpr int stride = max_length + 64; // room for the misalignment offset and decimation
+    puro::math::allocator<float> alloc;
+    float* memory;
+    float* pristine;
+};
+
+struct config
+{
+    int length;
+    int num_channels;
+    int offset; // in samples from 64-byte alignment
+};
+
+typedef std::function<void(operands&, const config&)> kernel_function;
+
+struct kernel
+{
+    const char* group;
+    const char* name;
+    int bytes_per_sample; // bytes read and written per processed sample
+    bool multichannel;
+    kernel_function run;
+};
+
+struct result
+{
+    const kernel* k;
+    config c;
+    double nanos;
+    double cycles;
+};
+
+volatile float sink = 0;
+
+std::vector<kernel> get_kernels()
+{
+    namespace m = puro::math;
+    typedef const config& C;
+    typedef operands& O;
+
+    const int f = sizeof(float);
+
+    return {
+        // math:: kernels, single channel
+        { "math", "multiply(value)",            2*f, false, [](O o, C c) { m::multiply(o.ptr(0,0,c.offset), 0.5f, c.length); } },
+        { "math", "multiply(src)",              3*f, false, [](O o, C c) { m::multiply(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length); } },
+        { "math", "multiply(src, value)",       2*f, false, [](O o, C c) { m::multiply(o.ptr(0,0,c.offset), (const float*)o.ptr(1,0,c.offset), 0.5f, c.length); } },
+        { "math", "multiply_add(src1, src2)",   4*f, false, [](O o, C c) { m::multiply_add(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), o.ptr(2,0,c.offset), c.length); } },
+        { "math", "multiply_add(src, value)",   3*f, false, [](O o, C c) { m::multiply_add(o.ptr(0,0,c.offset), (const float*)o.ptr(1,0,c.offset), 0.5f, c.length); } },
+        { "math", "add(src)",                   3*f, false, [](O o, C c) { m::add(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length); } },
+        { "math", "add(value)",                 2*f, false, [](O o, C c) { m::add(o.ptr(0,0,c.offset), 0.5f, c.length); } },
+        { "math", "substract",                  3*f, false, [](O o, C c) { m::substract(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length); } },
+        { "math", "copy",                       2*f, false, [](O o, C c) { m::copy(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length); } },
+        { "math", "copy_decimating(2)",         3*f, false, [](O o, C c) { m::copy_decimating(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), 2, c.length / 2); } },
+        { "math", "set",                        1*f, false, [](O o, C c) { m::set(o.ptr(0,0,c.offset), 0.5f, c.length); } },
+        { "math", "clear",                      1*f, false, [](O o, C c) { m::clear(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "max",                        2*f, false, [](O o, C c) { m::max(o.ptr(0,0,c.offset), 1.0f, c.length); } },
+        { "math", "clip_low",                   2*f, false, [](O o, C c) { m::clip_low(o.ptr(0,0,c.offset), 1.0f, c.length); } },
+        { "math", "reciprocal",                 2*f, false, [](O o, C c) { m::reciprocal(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "sin",                        2*f, false, [](O o, C c) { m::sin(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "cos",                        2*f, false, [](O o, C c) { m::cos(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "osc",                        1*f, false, [](O o, C c) { m::osc(o.ptr(0,0,c.offset), 0.01f, c.length); } },
+        { "math", "pow",                        2*f, false, [](O o, C c) { m::pow(o.ptr(0,0,c.offset), 1.5f, c.length); } },
+        { "math", "log",                        2*f, false, [](O o, C c) { m::log(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "sum",                        1*f, false, [](O o, C c) { sink = m::sum(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "abssum",                     1*f, false, [](O o, C c) { sink = m::abssum(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "normalise_energy",           3*f, false, [](O o, C c) { m::normalise_energy(o.ptr(0,0,c.offset), c.length); } },
+        { "math", "complex_multiply(src)",      3*f, false, [](O o, C c) { m::complex_multiply(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length); } },
+        { "math", "complex_multiply(src1, src2)", 3*f, false, [](O o, C c) { m::complex_multiply(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), o.ptr(2,0,c.offset), c.length); } },
+        { "math", "complex_magnitudes",         2*f, false, [](O o, C c) { m::complex_magnitudes(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length / 2); } },
+        { "math", "complex_phases(exact)",      2*f, false, [](O o, C c) { m::complex_phases<m::accuracy::exact>(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length / 2); } },
+        { "math", "complex_phases(fast)",       2*f, false, [](O o, C c) { m::complex_phases<m::accuracy::fast>(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), c.length / 2); } },
+        { "math", "complex_from_polar(exact)",  3*f, false, [](O o, C c) { m::complex_from_polar<m::accuracy::exact>(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), o.ptr(2,0,c.offset), c.length / 2); } },
+        { "math", "complex_from_polar(fast)",   3*f, false, [](O o, C c) { m::complex_from_polar<m::accuracy::fast>(o.ptr(0,0,c.offset), o.ptr(1,0,c.offset), o.ptr(2,0,c.offset), c.length / 2); } },
+
+        // buffer_operations, multichannel
+        { "buffer", "multiply_add(buf, buf)",   4*f, true, [](O o, C c) { puro::multiply_add(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset), o.get(2, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "multiply_add(buf, mono)",  4*f, true, [](O o, C c) { puro::multiply_add(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset), o.get(2, 1, c.length, c.offset)); } },
+        { "buffer", "multiply_add(buf, value)", 3*f, true, [](O o, C c) { puro::multiply_add(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset), 0.5f); } },
+        { "buffer", "multiply(value)",          2*f, true, [](O o, C c) { puro::multiply(o.get(0, c.num_channels, c.length, c.offset), 0.5f); } },
+        { "buffer", "multiply(buf)",            3*f, true, [](O o, C c) { puro::multiply(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "multiply(buf, value)",     2*f, true, [](O o, C c) { puro::multiply(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset), 0.5f); } },
+        { "buffer", "add(buf)",                 3*f, true, [](O o, C c) { puro::add(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "add(value)",               2*f, true, [](O o, C c) { puro::add(o.get(0, c.num_channels, c.length, c.offset), 0.5f); } },
+        { "buffer", "substract(buf)",           3*f, true, [](O o, C c) { puro::substract(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "copy",                     2*f, true, [](O o, C c) { puro::copy(o.get(0, c.num_channels, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "copy_downmixing",          2*f, true, [](O o, C c) { puro::copy_downmixing(o.get(0, 1, c.length, c.offset), o.get(1, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "clear",                    1*f, true, [](O o, C c) { puro::clear(o.get(0, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "normalise",                3*f, true, [](O o, C c) { puro::normalise(o.get(0, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "max",                      2*f, true, [](O o, C c) { puro::max(o.get(0, c.num_channels, c.length, c.offset), 1.0f); } },
+        { "buffer", "clip_low",                 2*f, true, [](O o, C c) { puro::clip_low(o.get(0, c.num_channels, c.length, c.offset), 1.0f); } },
+        { "buffer", "pow",                      2*f, true, [](O o, C c) { puro::pow(o.get(0, c.num_channels, c.length, c.offset), 1.5f); } },
+        { "buffer", "reciprocal",               2*f, true, [](O o, C c) { puro::reciprocal(o.get(0, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "log",                      2*f, true, [](O o, C c) { puro::log(o.get(0, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "negate",                   2*f, true, [](O o, C c) { puro::negate(o.get(0, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "sum",                      1*f, true, [](O o, C c) { sink = puro::sum(o.get(0, c.num_channels, c.length, c.offset)); } },
+        { "buffer", "abssum",                   1*f, true, [](O o, C c) { sink = puro::abssum(o.get(0, c.num_channels, c.length, c.offset)); } },
+    };
+}
+
+/** Cost of an empty measurement, subtracted from every result */
+double measure_timer_overhead()
+{
+    double best = 1e30;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const auto t0 = TscClock::now();
+        const auto t1 = TscClock::now_serialised();
+        best = puro::math::min(best, static_cast<double> (t1 - t0));
+    }
+    return best;
+}
+
+result run_kernel (const kernel& k, operands& o, const config& c, double overhead)
+{
+    const int reps = puro::math::max(min_reps, samples_per_config / (c.length * c.num_channels));
+
+    double best = 1e30;
+    for (int rep = 0; rep < reps; ++rep)
+    {
+        o.refill_destination(c.num_channels, c.length);
+
+        const auto t0 = TscClock::now();
+        k.run(o, c);
+        const auto t1 = TscClock::now_serialised();
+
+        best = puro::math::min(best, static_cast<double> (t1 - t0) - overhead);
+    }
+
+    best = puro::math::max(best, 1.0);
+
+    return { &k, c, TscClock::to_micros(static_cast<TscClock::ticks> (best)) * 1000.0, best };
+}
+
+void write_json (const char* path, const std::vector<result>& results)
+{
+    std::ofstream file (path);
+    file << "{\"ticks_per_micro\":" << TscClock::ticks_per_micro() << ",\"results\":[\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const result& r = results[i];
+        const double samples = static_cast<double> (r.c.length) * r.c.num_channels;
+        const double bytes = samples * r.k->bytes_per_sample;
+
+        file << "{\"group\":\"" << r.k->group << "\",\"kernel\":\"" << r.k->name << "\""
+             << ",\"length\":" << r.c.length
+             << ",\"channels\":" << r.c.num_channels
+             << ",\"aligned\":" << (r.c.offset == 0 ? "true" : "false")
+             << ",\"ns\":" << r.nanos
+             << ",\"cycles\":" << r.cycles
+             << ",\"samples_per_ns\":" << samples / r.nanos
+             << ",\"bytes_per_cycle\":" << bytes / r.cycles
+             << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    file << "]}\n";
+}
+
+} // namespace kernel_benchmark
+
+int main (int argc, char* argv[])
+{
+    using namespace kernel_benchmark;
+
+    const char* json_path = (argc > 1) ? argv[1] : "kernel_benchmark.json";
+
+    TscClock::calibration(); // calibrate once, before the first timed region
+    const double overhead = measure_timer_overhead();
+
+    operands o;
+    std::vector<kernel> kernels = get_kernels();
+    std::vector<result> results;
+
+    const int channel_counts [] = { 1, 2, 8 };
+    const int offsets [] = { 0, 1 };
+
+    std::cout << std::left << std::setw(8) << "group" << std::setw(32) << "kernel"
+              << std::right << std::setw(8) << "length" << std::setw(5) << "ch" << std::setw(8) << "align"
+              << std::setw(14) << "samples/ns" << std::setw(14) << "bytes/cycle" << "\n";
+
+    for (const kernel& k : kernels)
+    {
+        for (int length = 8; length <= max_length; length *= 2)
+        {
+            for (int num_channels : channel_counts)
+            {
+                if (!k.multichannel && num_channels != 1)
+                    continue;
+
+                for (int offset : offsets)
+                {
+                    const config c = { length, num_channels, offset };
+                    const result r = run_kernel(k, o, c, overhead);
+                    results.push_back(r);
+
+                    const double samples = static_cast<double> (length) * num_channels;
+
+                    std::cout << std::left << std::setw(8) << k.group << std::setw(32) << k.name
+                              << std::right << std::setw(8) << length << std::setw(5) << num_channels
+                              << std::setw(8) << (offset == 0 ? "yes" : "no")
+                              << std::fixed << std::setprecision(3)
+                              << std::setw(14) << samples / r.nanos
+                              << std::setw(14) << samples * k.bytes_per_sample / r.cycles << "\n";
+                }
+            }
+        }
+    }
+
+    write_json(json_path, results);
+    std::cout << "Wrote " << results.size() << " results to " << json_path << "\n";
+
+    return 0;
+}
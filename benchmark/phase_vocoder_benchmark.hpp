@@ -0,0 +1,171 @@
+#pragma once
+
+/**
+ Throughput of the phase vocoder, in frames per second per channel.
+
+ Sweeps fft size, channel count, a set of speed / pitch combinations and the exact and fast math::accuracy,
+ with a hop of a quarter of the fft size.
+ Every configuration renders from a noise source in blocks of 256 samples, and the time of each block is recorded
+ to an xrun_detector against the real-time deadline at 48 kHz to show the spikes of the blocks where frames are
+ computed. One frame costs two forward transforms and one inverse transform per channel.
+
+ Results are written as JSON to the first argument, default phase_vocoder_benchmark.json.
+ */
+
+#define PURO_USE_PROFILE 0
+
+#include "../src/puro.hpp"
+#include "../src/profiling.hpp"
+
+#include <fstream>
+
+namespace phase_vocoder_benchmark {
+
+constexpr double sample_rate = 48000.0;
+constexpr int source_length = 1 << 20;
+constexpr int block_size = 256;
+constexpr int samples_per_config = 1 << 18;
+
+struct config
+{
+    int fft_size;
+    int num_channels;
+    float speed;
+    float pitch;
+    bool fast;
+};
+
+struct result
+{
+    config c;
+    puro::xrun_detector::summary timing;
+    double frames_per_second_per_channel;
+    double realtime_factor;
+};
+
+template <int NumChannels, puro::math::accuracy Accuracy>
+result run (const config& c)
+{
+    static std::vector<float> source_data;
+    puro::buffer<NumChannels> source (source_length, source_data);
+    puro::noise(source);
+
+    std::vector<float> output_data;
+    puro::buffer<NumChannels> output (block_size, output_data);
+
+    const int hop_size = c.fft_size / 4;
+    puro::math::fft_plan_cache::prewarm(c.fft_size);
+    puro::phase_vocoder<NumChannels, Accuracy> vocoder (c.fft_size, hop_size);
+
+    puro::xrun_detector detector (block_size, sample_rate);
+
+    float position = source_length / 4;
+    const int num_blocks = samples_per_config / block_size;
+    double total_seconds = 0;
+
+    for (int block = -1; block < num_blocks; ++block) // first block is warm-up
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        position = vocoder.process(output, source, position, c.speed, c.pitch);
+        const auto t1 = std::chrono::steady_clock::now();
+
+        if (block < 0)
+            continue;
+
+        detector.record(t0, t1);
+        total_seconds += std::chrono::duration<double> (t1 - t0).count();
+    }
+
+    const double num_frames = static_cast<double> (num_blocks * block_size) / hop_size;
+
+    result r;
+    r.c = c;
+    r.timing = detector.get_summary();
+    r.frames_per_second_per_channel = num_frames * NumChannels / total_seconds;
+    r.realtime_factor = (num_blocks * block_size / sample_rate) / total_seconds;
+    return r;
+}
+
+template <int NumChannels>
+result run_with_channels (const config& c)
+{
+    return c.fast ? run<NumChannels, puro::math::accuracy::fast>(c) : run<NumChannels, puro::math::accuracy::exact>(c);
+}
+
+result run_config (const config& c)
+{
+    switch (c.num_channels)
+    {
+        case 1: return run_with_channels<1>(c);
+        case 2: return run_with_channels<2>(c);
+        default: return run_with_channels<8>(c);
+    }
+}
+
+void write_json (const char* path, const std::vector<result>& results)
+{
+    std::ofstream file (path);
+    file << "{\"sample_rate\":" << sample_rate << ",\"block_size\":" << block_size << ",\"results\":[\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const result& r = results[i];
+        file << "{\"fft_size\":" << r.c.fft_size
+             << ",\"hop_size\":" << r.c.fft_size / 4
+             << ",\"channels\":" << r.c.num_channels
+             << ",\"speed\":" << r.c.speed
+             << ",\"pitch\":" << r.c.pitch
+             << ",\"accuracy\":\"" << (r.c.fast ? "fast" : "exact") << "\""
+             << ",\"p50_ns\":" << r.timing.p50
+             << ",\"p99_ns\":" << r.timing.p99
+             << ",\"max_ns\":" << r.timing.max
+             << ",\"deadline_misses\":" << r.timing.num_misses
+             << ",\"frames_per_second_per_channel\":" << r.frames_per_second_per_channel
+             << ",\"realtime_factor\":" << r.realtime_factor
+             << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    file << "]}\n";
+}
+
+} // namespace phase_vocoder_benchmark
+
+int main (int argc, char* argv[])
+{
+    using namespace phase_vocoder_benchmark;
+
+    const char* json_path = (argc > 1) ? argv[1] : "phase_vocoder_benchmark.json";
+
+    const int fft_sizes [] = { 512, 1024, 2048, 4096 };
+    const int channel_counts [] = { 1, 2, 8 };
+    const std::pair<float, float> ratios [] = { { 1.0f, 1.0f }, { 0.25f, 1.0f }, { 0.5f, 0.75f } };
+
+    std::vector<result> results;
+
+    std::cout << std::setw(6) << "fft" << std::setw(4) << "ch" << std::setw(7) << "speed" << std::setw(7) << "pitch" << std::setw(7) << "math"
+              << std::setw(11) << "p50 us" << std::setw(11) << "p99 us" << std::setw(9) << "misses"
+              << std::setw(16) << "frames/s/ch" << std::setw(11) << "x realtime" << "\n";
+
+    for (int num_channels : channel_counts)
+    for (int fft_size : fft_sizes)
+    for (const auto& ratio : ratios)
+    for (bool fast : { false, true })
+    {
+        const config c = { fft_size, num_channels, ratio.first, ratio.second, fast };
+        const result r = run_config(c);
+        results.push_back(r);
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(6) << fft_size << std::setw(4) << num_channels
+                  << std::setw(7) << c.speed << std::setw(7) << c.pitch << std::setw(7) << (fast ? "fast" : "exact")
+                  << std::setw(11) << r.timing.p50 / 1000.0 << std::setw(11) << r.timing.p99 / 1000.0
+                  << std::setw(9) << r.timing.num_misses
+                  << std::setw(16) << std::setprecision(0) << r.frames_per_second_per_channel
+                  << std::setw(11) << std::setprecision(1) << r.realtime_factor << "\n";
+    }
+
+    write_json(json_path, results);
+    std::cout << "Wrote " << results.size() << " results to " << json_path << "\n";
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+/**
+ Effect of the channel stride on multichannel kernels: heap_block, whose stride is the channel length rounded to
+ a cache line, against planar_block, whose stride is padded to an odd number of cache lines.
+
+ With power-of-two lengths the heap_block channels of dst, src1 and src2 all start on the same cache sets.
+ Two access orders are measured for dst += src1 * src2:
+    - channel-major: puro::multiply_add, one channel after another, 3 concurrent streams
+    - sample-major: all channels of a sample before the next sample, as in mixing and panning matrices,
+      3 * channels concurrent streams, which is where set conflicts show up
+
+ The fastest of many calls is reported in nanoseconds per sample per channel, so the numbers are warm-cache best
+ cases. Results are written as JSON to the first argument, default stride_benchmark.json.
+ */
+
+#include "../src/puro.hpp"
+
+#include <fstream>
+
+namespace stride_benchmark {
+
+constexpr int samples_per_config = 1 << 22;
+constexpr int min_reps = 16;
+
+struct config
+{
+    int length;
+    int num_channels;
+    bool sample_major;
+};
+
+struct result
+{
+    config c;
+    double packed_ns;
+    double padded_ns;
+};
+
+template <int NumChannels>
+void multiply_add_sample_major (puro::buffer<NumChannels> dst, puro::buffer<NumChannels> src1, puro::buffer<NumChannels> src2)
+{
+    for (int i = 0; i < dst.length(); ++i)
+        for (int ch = 0; ch < NumChannels; ++ch)
+            dst.channel(ch)[i] += src1.channel(ch)[i] * src2.channel(ch)[i];
+}
+
+/** Best time of dst += src1 * src2 in ns per sample per channel, with all operands allocated from MemorySource */
+template <int NumChannels, typename MemorySource>
+double measure (const config& c)
+{
+    MemorySource memory [3] = { { NumChannels, c.length }, { NumChannels, c.length }, { NumChannels, c.length } };
+
+    puro::buffer<NumChannels> dst (c.length, memory[0]);
+    puro::buffer<NumChannels> src1 (c.length, memory[1]);
+    puro::buffer<NumChannels> src2 (c.length, memory[2]);
+
+    puro::constant(dst, 0.0f);
+    puro::constant(src1, 0.5f);
+    puro::constant(src2, 0.25f);
+
+    const int reps = puro::math::max(min_reps, samples_per_config / (c.length * NumChannels));
+    double best = 1e30;
+
+    for (int rep = -1; rep < reps; ++rep) // first call is warm-up
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+
+        if (c.sample_major)
+            multiply_add_sample_major(dst, src1, src2);
+        else
+            puro::multiply_add(dst, src1, src2);
+
+        const auto t1 = std::chrono::steady_clock::now();
+
+        if (rep >= 0)
+            best = puro::math::min(best, std::chrono::duration<double, std::nano> (t1 - t0).count());
+    }
+
+    return best / (static_cast<double> (c.length) * NumChannels);
+}
+
+template <int NumChannels>
+result run (const config& c)
+{
+    result r;
+    r.c = c;
+    r.packed_ns = measure<NumChannels, puro::heap_block<float, puro::math::allocator<float>>>(c);
+    r.padded_ns = measure<NumChannels, puro::planar_block<float>>(c);
+    return r;
+}
+
+result run_config (const config& c)
+{
+    switch (c.num_channels)
+    {
+        case 2: return run<2>(c);
+        case 8: return run<8>(c);
+        default: return run<16>(c);
+    }
+}
+
+void write_json (const char* path, const std::vector<result>& results)
+{
+    std::ofstream file (path);
+    file << "{\"results\":[\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const result& r = results[i];
+        file << "{\"length\":" << r.c.length
+             << ",\"channels\":" << r.c.num_channels
+             << ",\"order\":\"" << (r.c.sample_major ? "sample-major" : "channel-major") << "\""
+             << ",\"packed_ns_per_sample\":" << r.packed_ns
+             << ",\"padded_ns_per_sample\":" << r.padded_ns
+             << ",\"speedup\":" << r.packed_ns / r.padded_ns
+             << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    file << "]}\n";
+}
+
+} // namespace stride_benchmark
+
+int main (int argc, char* argv[])
+{
+    using namespace stride_benchmark;
+
+    const char* json_path = (argc > 1) ? argv[1] : "stride_benchmark.json";
+
+    const int lengths [] = { 256, 1024, 4096, 16384, 65536 };
+    const int channel_counts [] = { 2, 8, 16 };
+
+    std::vector<result> results;
+
+    std::cout << std::setw(14) << "order" << std::setw(4) << "ch" << std::setw(8) << "length"
+              << std::setw(12) << "packed ns" << std::setw(12) << "padded ns" << std::setw(9) << "speedup" << "\n";
+
+    for (bool sample_major : { false, true })
+    for (int num_channels : channel_counts)
+    for (int length : lengths)
+    {
+        const config c = { length, num_channels, sample_major };
+        const result r = run_config(c);
+        results.push_back(r);
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << std::setw(14) << (sample_major ? "sample-major" : "channel-major")
+                  << std::setw(4) << num_channels << std::setw(8) << length
+                  << std::setw(12) << r.packed_ns << std::setw(12) << r.padded_ns
+                  << std::setw(9) << std::setprecision(2) << r.packed_ns / r.padded_ns << "\n";
+    }
+
+    write_json(json_path, results);
+    std::cout << "Wrote " << results.size() << " results to " << json_path << "\n";
+
+    return 0;
+}
@@ -383,5 +383,121 @@ struct dynamic_buffer
     }
 };
 
+/**
+ Spectrum in the internal order of pffft, produced by math::fft::rfft when the destination is an unordered_spectrum.
+ The ordered transforms reorder the result to interleaved complex numbers, which this skips. As the bins are not in
+ a meaningful order, only math::fft transforms and math::fft::convolve_accumulate operate on this type. It is
+ deliberately not a buffer type, and the ordered spectrum functions refuse it, so the two formats can't be mixed.
+ */
+template <int NumChannels, typename T = float>
+struct unordered_spectrum
+{
+    typedef T value_type;
+
+    int num_samples = 0;
+    T* ptrs [NumChannels] = { 0 };
+
+    constexpr static inline int num_channels() { return NumChannels; }
+    inline int length() const { return num_samples; }
+
+    inline T* channel(int ch) const
+    {
+        errorif(ch < 0 || ch >= this->num_channels(), "channel out of range");
+        return ptrs[ch];
+    }
+
+    inline void clear() const
+    {
+        for (int ch=0; ch < NumChannels; ++ch)
+        {
+            math::clear(channel(ch), num_samples);
+        }
+    }
+
+    // ctors
+
+    inline unordered_spectrum() {};
+
+    inline unordered_spectrum(int length) : num_samples(length) {};
+
+    inline unordered_spectrum(int length, T* const * channel_ptrs) : num_samples(length)
+    {
+        for (int ch = 0; ch < num_channels(); ++ch)
+            ptrs[ch] = channel_ptrs[ch];
+    }
+
+    template <typename MemorySource>
+    inline unordered_spectrum (int length, MemorySource& ms,
+                               typename enable_if_memory_source<MemorySource>::type* dummy = 0)
+                               : num_samples(length)
+    {
+        ms.assign_allocated(ptrs, NumChannels, num_samples);
+    }
+};
+
+/**
+ Interleaved multichannel buffer, frames of NumChannels samples one after another as host APIs and file formats
+ use them. There are no channel pointers, so most buffer operations don't accept it. copy(), add() and multiply()
+ have overloads that convert to and from the planar buffers with the interleave kernels of math_vector.hpp.
+ */
+template <int NumChannels, typename T = float>
+struct interleaved_buffer
+{
+    typedef T value_type;
+
+    T* data = nullptr;
+    int num_samples = 0;
+
+    constexpr static inline int num_channels() { return NumChannels; }
+    inline int length() const { return num_samples; }
+
+    /** Number of values, which is length() * num_channels() */
+    inline int size() const { return num_samples * NumChannels; }
+
+    inline T* frame(int index) const
+    {
+        errorif(index < 0 || index >= num_samples, "frame out of range");
+        return &data[index * NumChannels];
+    }
+
+    inline void clear() const
+    {
+        math::clear(data, size());
+    }
+
+    inline interleaved_buffer sub (int offset, int n) const
+    {
+        errorif(offset < 0, "offset below zero");
+        errorif(n < 0, "negative length");
+        errorif(offset + n > length(), "sub end exceeds the number of samples available");
+
+        return interleaved_buffer (n, &data[offset * NumChannels]);
+    }
+
+    // ctors
+
+    inline interleaved_buffer() {};
+
+    inline interleaved_buffer(int length, T* interleaved_data) : data(interleaved_data), num_samples(length) {};
+
+    /** Single channel of length * NumChannels values from the memory source */
+    template <typename MemorySource>
+    inline interleaved_buffer (int length, MemorySource& ms,
+                               typename enable_if_memory_source<MemorySource>::type* dummy = 0)
+                               : num_samples(length)
+    {
+        ms.assign_allocated(&data, 1, length * NumChannels);
+    }
+
+    inline interleaved_buffer (int length, std::vector<value_type>& vec)
+    : num_samples(length)
+    {
+        if (vec.size() < static_cast<size_t> (length * NumChannels))
+            vec.resize(length * NumChannels);
+
+        data = vec.data();
+    }
+};
+
 } // namespace puro
 
@@ -230,6 +230,33 @@ inline void copy (BT1 dst, const BT2 src)
     }
 }
 
+/**
+ Copy with conversion between float and integer sample formats: int16_t, int24 (packed 24-bit) and int32_t, to and
+ from float or double buffers, and between float and the float16 and bfloat16 storage formats. Floats in [-1, 1) use the whole integer range, values outside are saturated.
+ Conversions to integers are rounded to nearest, with optional dither from the given noise source.
+ */
+template <math::dither Dither = math::dither::none, typename BT1, typename BT2>
+inline void convert (BT1 dst, const BT2 src, math::dither_noise* noise = nullptr)
+{
+    errorif(dst.num_channels() != src.num_channels(), "dst and src channel number doesn't match");
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+
+    typedef typename BT1::value_type dst_type;
+    typedef typename BT2::value_type src_type;
+
+    for (int ch=0; ch<dst.num_channels(); ++ch)
+    {
+        if constexpr (std::is_same<dst_type, float16>::value || std::is_same<dst_type, bfloat16>::value)
+            math::float_to_half(dst.channel(ch), src.channel(ch), dst.length());
+        else if constexpr (std::is_same<src_type, float16>::value || std::is_same<src_type, bfloat16>::value)
+            math::half_to_float(dst.channel(ch), src.channel(ch), dst.length());
+        else if constexpr (std::is_floating_point<dst_type>::value)
+            math::int_to_float(dst.channel(ch), src.channel(ch), dst.length());
+        else
+            math::float_to_int<Dither>(dst.channel(ch), src.channel(ch), dst.length(), noise);
+    }
+}
+
 template <typename BT1, typename BT2>
 inline void copy_decimating(BT1 dst, BT2 src, int stride)
 {
@@ -379,6 +406,188 @@ inline void clip_low(BT dst, const typename BT::value_type low)
         math::clip_low(dst.channel(ch), low, dst.length());
     }
 }
+
+template <typename BT>
+inline void flush_denormals(BT buffer)
+{
+    for (int ch = 0; ch < buffer.num_channels(); ++ch)
+    {
+        math::flush_denormals(buffer.channel(ch), buffer.length());
+    }
+}
+
+/** One-pole lowpass per channel, see math::one_pole. states holds one value per channel and is updated. */
+template <bool DenormalSafe = false, typename BT1, typename BT2>
+inline void one_pole(BT1 dst, const BT2 src, const typename BT1::value_type coeff, typename BT1::value_type* states)
+{
+    errorif(dst.num_channels() != src.num_channels(), "dst and src channel number doesn't match");
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+
+    for (int ch = 0; ch < dst.num_channels(); ++ch)
+    {
+        states[ch] = math::one_pole<DenormalSafe>(dst.channel(ch), src.channel(ch), coeff, states[ch], dst.length());
+    }
+}
     
+/*
+ Overloads for fixed_buffer operands of equal length, using the fully unrolled math kernels. A mono src is
+ broadcast to all channels of dst, as in the runtime-length versions.
+ */
+
+template <int NumChannels, int SrcChannels, int Length, typename T>
+inline void copy (fixed_buffer<NumChannels, Length, T> dst, const fixed_buffer<SrcChannels, Length, T> src)
+{
+    static_assert(NumChannels == SrcChannels, "dst and src channel number doesn't match");
+
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::copy<Length>(dst.channel(ch), src.channel(ch));
+}
+
+template <int NumChannels, int Length, typename T>
+inline void clear (fixed_buffer<NumChannels, Length, T> buffer)
+{
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::clear<Length>(buffer.channel(ch));
+}
+
+template <int NumChannels, int SrcChannels, int Length, typename T>
+inline void add (fixed_buffer<NumChannels, Length, T> dst, const fixed_buffer<SrcChannels, Length, T> src)
+{
+    static_assert(NumChannels == SrcChannels || SrcChannels == 1, "channel config not implemented");
+
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::add<Length>(dst.channel(ch), src.channel(SrcChannels == 1 ? 0 : ch));
+}
+
+template <int NumChannels, int Length, typename T>
+inline void add (fixed_buffer<NumChannels, Length, T> dst, const T value)
+{
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::add<Length>(dst.channel(ch), value);
+}
+
+template <int NumChannels, int SrcChannels, int Length, typename T>
+inline void substract (fixed_buffer<NumChannels, Length, T> dst, const fixed_buffer<SrcChannels, Length, T> src)
+{
+    static_assert(NumChannels == SrcChannels || SrcChannels == 1, "channel config not implemented");
+
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::substract<Length>(dst.channel(ch), src.channel(SrcChannels == 1 ? 0 : ch));
+}
+
+template <int NumChannels, int SrcChannels, int Length, typename T>
+inline void multiply (fixed_buffer<NumChannels, Length, T> dst, const fixed_buffer<SrcChannels, Length, T> src)
+{
+    static_assert(NumChannels == SrcChannels || SrcChannels == 1, "channel config not implemented");
+
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::multiply<Length>(dst.channel(ch), src.channel(SrcChannels == 1 ? 0 : ch));
+}
+
+template <int NumChannels, int Length, typename T>
+inline void multiply (fixed_buffer<NumChannels, Length, T> dst, const T value)
+{
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::multiply<Length>(dst.channel(ch), value);
+}
+
+template <int NumChannels, int Src1Channels, int Src2Channels, int Length, typename T>
+inline void multiply_add (fixed_buffer<NumChannels, Length, T> dst, const fixed_buffer<Src1Channels, Length, T> src1, const fixed_buffer<Src2Channels, Length, T> src2)
+{
+    static_assert(NumChannels == Src1Channels, "dst and src1 channel number doesn't match");
+    static_assert(Src1Channels == Src2Channels || Src2Channels == 1, "channel config not implemented");
+
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::multiply_add<Length>(dst.channel(ch), src1.channel(ch), src2.channel(Src2Channels == 1 ? 0 : ch));
+}
+
+template <int NumChannels, int SrcChannels, int Length, typename T>
+inline void multiply_add (fixed_buffer<NumChannels, Length, T> dst, const fixed_buffer<SrcChannels, Length, T> src, const T multiplier)
+{
+    static_assert(NumChannels == SrcChannels, "dst and src channel number doesn't match");
+
+    for (int ch = 0; ch < NumChannels; ++ch)
+        math::multiply_add<Length>(dst.channel(ch), src.channel(ch), multiplier);
+}
+
+
+/** Interleaved src to planar dst */
+template <typename BT, int NumChannels>
+inline void copy (BT dst, const interleaved_buffer<NumChannels, float> src)
+{
+    errorif(dst.num_channels() != NumChannels, "dst and src channel number doesn't match");
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+
+    math::deinterleave<NumChannels>(dst.ptrs, src.data, dst.length());
+}
+
+/** Planar src to interleaved dst */
+template <int NumChannels, typename BT>
+inline void copy (interleaved_buffer<NumChannels, float> dst, const BT src)
+{
+    errorif(src.num_channels() != NumChannels, "dst and src channel number doesn't match");
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+
+    math::interleave<NumChannels>(dst.data, src.ptrs, dst.length());
+}
+
+template <int NumChannels>
+inline void copy (interleaved_buffer<NumChannels, float> dst, const interleaved_buffer<NumChannels, float> src)
+{
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+    math::copy(dst.data, src.data, dst.size());
+}
+
+/** Interleaved src added to planar dst */
+template <typename BT, int NumChannels>
+inline void add (BT dst, const interleaved_buffer<NumChannels, float> src)
+{
+    errorif(dst.num_channels() != NumChannels, "dst and src channel number doesn't match");
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+
+    math::deinterleave<NumChannels, true>(dst.ptrs, src.data, dst.length());
+}
+
+/** Planar src added to interleaved dst */
+template <int NumChannels, typename BT>
+inline void add (interleaved_buffer<NumChannels, float> dst, const BT src)
+{
+    errorif(src.num_channels() != NumChannels, "dst and src channel number doesn't match");
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+
+    math::interleave<NumChannels, true>(dst.data, src.ptrs, dst.length());
+}
+
+template <int NumChannels>
+inline void add (interleaved_buffer<NumChannels, float> dst, const interleaved_buffer<NumChannels, float> src)
+{
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+    math::add(dst.data, src.data, dst.size());
+}
+
+template <int NumChannels>
+inline void add (interleaved_buffer<NumChannels, float> dst, const float value)
+{
+    math::add(dst.data, value, dst.size());
+}
+
+template <int NumChannels>
+inline void multiply (interleaved_buffer<NumChannels, float> dst, const float value)
+{
+    math::multiply(dst.data, value, dst.size());
+}
+
+template <int NumChannels>
+inline void multiply (interleaved_buffer<NumChannels, float> dst, const interleaved_buffer<NumChannels, float> src)
+{
+    errorif(dst.length() != src.length(), "dst and src lengths don't match");
+    math::multiply(dst.data, src.data, dst.size());
+}
+
+template <int NumChannels>
+inline void clear (interleaved_buffer<NumChannels, float> buffer)
+{
+    buffer.clear();
+}
 
 } // namespace puro
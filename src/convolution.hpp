@@ -0,0 +1,435 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Uniformly partitioned overlap-save convolution.
+
+ The impulse response is split into partitions of block_size samples, and each partition is transformed once to a
+ spectrum of fft_size = 2 * block_size. Every call to process() transforms the latest 2 * block_size input samples,
+ stores the spectrum to a frequency-domain delay line, and accumulates the products of the delay line with the
+ partition spectra. A single inverse transform then gives the output block, so the cost per block is constant:
+ two FFTs and num_partitions complex multiply-adds. Spectra are kept in the internal order of pffft, so the
+ transforms skip the reordering passes and the multiply-adds use pffft_zconvolve_accumulate.
+
+ There is no latency on top of the block itself. The impulse response may have a single channel, which is then
+ used for all channels, or NumChannels channels. All memory is allocated on construction and process() doesn't
+ lock. The transform work buffer is per thread and allocated on first use, so call
+ math::fft_plan_cache::prewarm(2 * block_size) on the audio thread beforehand. Block size should be a multiple of 16,
+ as required by pffft real transforms.
+ */
+template <int NumChannels>
+struct uniform_convolver
+{
+    typedef float value_type;
+    typedef buffer<NumChannels, float> buffer_type;
+    typedef unordered_spectrum<NumChannels, float> spectrum_type;
+
+    template <typename BT>
+    uniform_convolver (int block_size, BT impulse_response)
+    : block_size(block_size)
+    , fft_size(2 * block_size)
+    , num_partitions(math::max(1, (impulse_response.length() + block_size - 1) / block_size))
+    , num_ir_channels(impulse_response.num_channels())
+    , transform(2 * block_size)
+    , ir_memory(num_partitions * impulse_response.num_channels(), 2 * block_size)
+    , fdl_memory(num_partitions * NumChannels, 2 * block_size)
+    , work_memory(2 * NumChannels, 2 * block_size)
+    , fdl_index(0)
+    {
+        errorif(block_size <= 0 || block_size % 16 != 0, "block size should be a positive multiple of 16");
+        errorif(num_ir_channels != 1 && num_ir_channels != NumChannels, "impulse response should have 1 or NumChannels channels");
+
+        set_impulse_response(impulse_response);
+        reset();
+    }
+
+    uniform_convolver (const uniform_convolver&) = delete;
+    uniform_convolver& operator= (const uniform_convolver&) = delete;
+
+    /**
+     Replace the partition spectra. The new impulse response can't be longer than the one given on construction.
+     Doesn't allocate, but transforms every partition, so it's not meant to be called for every block.
+     */
+    template <typename BT>
+    void set_impulse_response (BT impulse_response)
+    {
+        errorif(impulse_response.length() > num_partitions * block_size, "impulse response longer than allocated");
+        errorif(impulse_response.num_channels() != num_ir_channels, "impulse response channel count changed");
+
+        // the normalisation of the inverse transform is folded into the partition spectra
+        const float scale = 1.0f / static_cast<float> (fft_size);
+
+        for (int p = 0; p < num_partitions; ++p)
+        {
+            const int start = math::min(p * block_size, impulse_response.length());
+            const int n = math::min(block_size, impulse_response.length() - start);
+
+            for (int ch = 0; ch < num_ir_channels; ++ch)
+            {
+                float* spectrum = ir_memory.ptrs[p * num_ir_channels + ch];
+
+                math::clear(spectrum, fft_size);
+                math::copy(spectrum, impulse_response.channel(ch) + start, n);
+
+                transform.transform(spectrum, spectrum, transform.work_buffer(), PFFFT_FORWARD, false);
+                math::multiply(spectrum, scale, fft_size);
+            }
+        }
+    }
+
+    /** Clear the input history and the delay line */
+    void reset()
+    {
+        for (int i = 0; i < num_partitions * NumChannels; ++i)
+            math::clear(fdl_memory.ptrs[i], fft_size);
+
+        input_buffer().clear();
+        fdl_index = 0;
+    }
+
+    /** Convolve a single block. Both buffers should be block_size long, dst and src can be the same buffer. */
+    template <typename BT1, typename BT2>
+    void process (BT1 dst, const BT2 src)
+    {
+        errorif(dst.length() != block_size, "dst length should equal block size");
+        errorif(src.length() != block_size, "src length should equal block size");
+        errorif(dst.num_channels() != NumChannels || src.num_channels() != NumChannels, "channel configs not identical");
+
+        // slide the input window and transform it to the current slot of the delay line
+        buffer_type input = input_buffer();
+        for (int ch = 0; ch < NumChannels; ++ch)
+        {
+            math::copy(input.channel(ch), input.channel(ch) + block_size, block_size);
+            math::copy(input.channel(ch) + block_size, src.channel(ch), block_size);
+        }
+
+        transform.rfft(fdl_slot(fdl_index), input);
+
+        // accumulate the delayed input spectra with the partition spectra
+        spectrum_type accum = accum_spectrum();
+        accum.clear();
+
+        for (int p = 0; p < num_partitions; ++p)
+        {
+            int slot = fdl_index - p;
+            if (slot < 0)
+                slot += num_partitions;
+
+            transform.convolve_accumulate(accum, fdl_slot(slot), ir_partition(p));
+        }
+
+        buffer_type result = accum_buffer();
+        transform.irfft(result, accum, false);
+
+        // the first half of the result is circular aliasing, the second half is the output
+        for (int ch = 0; ch < NumChannels; ++ch)
+            math::copy(dst.channel(ch), result.channel(ch) + block_size, block_size);
+
+        if (++fdl_index == num_partitions)
+            fdl_index = 0;
+    }
+
+    /** Length of the impulse response that fits the partitions */
+    int max_ir_length() const { return num_partitions * block_size; }
+
+    spectrum_type fdl_slot (int slot) const
+    {
+        return spectrum_type (fft_size, &fdl_memory.ptrs[slot * NumChannels]);
+    }
+
+    /** Partition spectrum, a mono impulse response is broadcast to all channels */
+    spectrum_type ir_partition (int p) const
+    {
+        spectrum_type buf (fft_size);
+        for (int ch = 0; ch < NumChannels; ++ch)
+            buf.ptrs[ch] = ir_memory.ptrs[p * num_ir_channels + (num_ir_channels == 1 ? 0 : ch)];
+        return buf;
+    }
+
+    buffer_type input_buffer() const { return buffer_type (fft_size, &work_memory.ptrs[0]); }
+    buffer_type accum_buffer() const { return buffer_type (fft_size, &work_memory.ptrs[NumChannels]); }
+    spectrum_type accum_spectrum() const { return spectrum_type (fft_size, &work_memory.ptrs[NumChannels]); }
+
+    const int block_size;
+    const int fft_size;
+    const int num_partitions;
+    const int num_ir_channels;
+
+    math::fft transform;
+
+    heap_block<float, math::allocator<float>> ir_memory;
+    heap_block<float, math::allocator<float>> fdl_memory;
+    heap_block<float, math::allocator<float>> work_memory;
+
+    int fdl_index;
+};
+
+/**
+ One level of the tail of non_uniform_convolver: a uniform_convolver with a larger block, processed ahead of time
+ on its own worker thread. The stage covers the impulse response from offset 2 * block_size, so the worker has the
+ duration of a whole stage block between receiving the input and the output being needed.
+
+ Job n convolves the input collected in stage block n, and its output is played in stage block n + 2. Inputs are
+ queued in num_input_slots slots, so a worker that falls behind still processes every block in order and the tail
+ stays time-aligned. Outputs are double-buffered, job n writes output n % 2.
+ */
+template <int NumChannels>
+struct convolver_tail_stage
+{
+    typedef buffer<NumChannels, float> buffer_type;
+
+    template <typename BT>
+    convolver_tail_stage (int block_size, BT impulse_response_segment, bool use_worker_thread)
+    : block_size(block_size)
+    , convolver(block_size, impulse_response_segment)
+    , memory((num_input_slots + 2) * NumChannels, block_size)
+    , position(0)
+    , collecting(true)
+    , previous_job(-1)
+    , played_job(-2)
+    , num_requested(0)
+    , num_completed(0)
+    , num_missed(0)
+    , running(true)
+    {
+        for (int i = 0; i < (num_input_slots + 2) * NumChannels; ++i)
+            math::clear(memory.ptrs[i], block_size);
+
+        if (use_worker_thread)
+            worker = std::thread ([this]() { run(); });
+    }
+
+    ~convolver_tail_stage()
+    {
+        if (worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock (mutex);
+                running = false;
+            }
+
+            condition.notify_one();
+            worker.join();
+        }
+    }
+
+    convolver_tail_stage (const convolver_tail_stage&) = delete;
+    convolver_tail_stage& operator= (const convolver_tail_stage&) = delete;
+
+    buffer_type input (int64_t job) const
+    {
+        return buffer_type (block_size, &memory.ptrs[static_cast<int> (job % num_input_slots) * NumChannels]);
+    }
+
+    buffer_type output (int64_t job) const
+    {
+        return buffer_type (block_size, &memory.ptrs[(num_input_slots + static_cast<int> (job & 1)) * NumChannels]);
+    }
+
+    /** Audio thread: store the input block */
+    template <typename BT>
+    void push_input (const BT src)
+    {
+        errorif(position + src.length() > block_size, "block size should divide the stage block size");
+
+        if (collecting)
+            copy(input(num_requested.load(std::memory_order_relaxed)).sub(position, src.length()), src);
+    }
+
+    /**
+     Audio thread: add the output to dst, and hand the input over to the worker once a whole stage block is collected.
+
+     The output of a job that isn't finished by the time it's needed is dropped: the stage is silent for that stage
+     block and the miss is counted, later jobs are still played in their own blocks. If the worker is so far behind
+     that all input slots are queued, the next stage block can't be stored and is lost as well. The convolver then
+     misses that block of input, which leaves the tail wrong for num_partitions stage blocks.
+     */
+    template <typename BT>
+    void add_output (BT dst)
+    {
+        if (played_job != no_job)
+            add(dst, output(played_job).sub(position, dst.length()));
+
+        position += dst.length();
+
+        if (position == block_size)
+        {
+            position = 0;
+
+            const int64_t collected_job = collecting ? num_requested.load(std::memory_order_relaxed) : no_job;
+            if (collecting)
+                request();
+
+            // jobs complete in order, so the output is ready and nothing writes to it once the count has passed it
+            const int64_t completed = num_completed.load(std::memory_order_acquire);
+            played_job = (previous_job != no_job && completed > previous_job) ? previous_job : no_job;
+            previous_job = collected_job;
+
+            if (played_job == no_job)
+                num_missed.store(num_missed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+            // the next input slot is free once the job that used it last is done
+            collecting = num_requested.load(std::memory_order_relaxed) - completed < num_input_slots;
+        }
+    }
+
+    /** Number of stage blocks that were silent because their job wasn't finished in time or their input was lost */
+    int64_t num_missed_deadlines() const { return num_missed.load(std::memory_order_relaxed); }
+
+    void request()
+    {
+        const int64_t job = num_requested.load(std::memory_order_relaxed);
+
+        if (! worker.joinable())
+        {
+            compute(job);
+            num_requested.store(job + 1, std::memory_order_relaxed);
+            num_completed.store(job + 1, std::memory_order_release);
+            return;
+        }
+
+        num_requested.store(job + 1, std::memory_order_release);
+
+        // only notify if the lock is free, holding it means that the worker is between jobs and checking for new
+        // ones, and can miss this one; it then picks it up on its next periodic wake-up
+        if (mutex.try_lock())
+        {
+            mutex.unlock();
+            condition.notify_one();
+        }
+    }
+
+    void compute (int64_t job)
+    {
+        convolver.process(output(job), input(job));
+    }
+
+    void run()
+    {
+        denormal_guard guard;
+        int64_t num_done = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock (mutex);
+                while (running && num_requested.load(std::memory_order_acquire) == num_done)
+                    condition.wait_for(lock, wake_interval);
+
+                if (! running)
+                    return;
+            }
+
+            compute(num_done);
+            num_completed.store(++num_done, std::memory_order_release);
+        }
+    }
+
+    /** Number of stage blocks the worker can fall behind by before input is lost */
+    static constexpr int num_input_slots = 4;
+
+    /** Longest time the worker can miss a request for, see request() */
+    static constexpr std::chrono::microseconds wake_interval { 500 };
+
+    static constexpr int64_t no_job = std::numeric_limits<int64_t>::min();
+
+    const int block_size;
+    uniform_convolver<NumChannels> convolver;
+    heap_block<float, math::allocator<float>> memory;
+
+    int position;
+
+    // audio thread: whether the current stage block is being stored, the job collected in the previous stage block
+    // and the job whose output is being played, no_job if there is none; the zeroed outputs of the jobs before the
+    // first one are played at the start
+    bool collecting;
+    int64_t previous_job;
+    int64_t played_job;
+
+    std::atomic<int64_t> num_requested;
+    std::atomic<int64_t> num_completed;
+    std::atomic<int64_t> num_missed;
+    bool running;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread worker;
+};
+
+/**
+ Non-uniformly partitioned convolution for long impulse responses at small block sizes.
+
+ The head of the impulse response is convolved on the audio thread with a uniform_convolver of the engine block
+ size. The rest is split into tail stages with block sizes growing by the given factor, each covering the
+ impulse response from twice its block size up to where the next stage starts. Tail stages run on worker threads
+ and their results are ready before they are needed, so the only latency is the engine block and the audio thread
+ cost is the head plus copying. Setting use_worker_threads to false processes the tail inline, which is useful for
+ offline rendering.
+
+ process() doesn't lock or wait on the worker threads. A block is handed to a worker with an atomic store followed
+ by a notify if the worker's mutex can be taken without blocking; otherwise the worker finds the block on its next
+ periodic wake-up, at most half a millisecond later. If a worker hasn't finished a block by the time its output is
+ needed, that output is dropped and the stage is silent for one of its blocks, the worker keeps processing the
+ queued blocks and later ones play at their own time. Only a worker that is num_input_slots stage blocks behind
+ loses input, which corrupts that stage's part of the tail for an impulse response segment. Dropped blocks are
+ counted in num_missed_deadlines(), so an overloaded machine shows up as dropouts in the tail instead of stalling
+ the audio thread.
+ */
+template <int NumChannels>
+struct non_uniform_convolver
+{
+    template <typename BT>
+    non_uniform_convolver (int block_size, BT impulse_response, int growth = 8, bool use_worker_threads = true)
+    : block_size(block_size)
+    , head(block_size, impulse_response.sub(0, math::min(impulse_response.length(), 2 * growth * block_size)))
+    {
+        errorif(growth < 2, "growth factor should be at least 2");
+
+        int stage_block_size = growth * block_size;
+        int offset = 2 * stage_block_size;
+
+        while (offset < impulse_response.length())
+        {
+            const int next_block_size = growth * stage_block_size;
+            const int end = math::min(impulse_response.length(), 2 * next_block_size);
+
+            tail.emplace_back(new convolver_tail_stage<NumChannels> (stage_block_size,
+                                                                     impulse_response.sub(offset, end - offset),
+                                                                     use_worker_threads));
+            stage_block_size = next_block_size;
+            offset = end;
+        }
+    }
+
+    /** Convolve a single block. Both buffers should be block_size long, dst and src can be the same buffer. */
+    template <typename BT1, typename BT2>
+    void process (BT1 dst, const BT2 src)
+    {
+        for (auto& stage : tail)
+            stage->push_input(src);
+
+        head.process(dst, src);
+
+        for (auto& stage : tail)
+            stage->add_output(dst);
+    }
+
+    int num_stages() const { return 1 + static_cast<int> (tail.size()); }
+
+    /** Number of tail stage blocks that weren't ready in time, summed over all stages */
+    int64_t num_missed_deadlines() const
+    {
+        int64_t n = 0;
+        for (auto& stage : tail)
+            n += stage->num_missed_deadlines();
+        return n;
+    }
+
+    const int block_size;
+    uniform_convolver<NumChannels> head;
+    std::vector<std::unique_ptr<convolver_tail_stage<NumChannels>>> tail;
+};
+
+
+} // namespace puro
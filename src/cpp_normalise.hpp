@@ -121,6 +121,49 @@
     // TODO
 #endif
 
+/********************************************
+ ** SIMD instruction sets
+ *******************************************/
+
+#if !defined(PURO_SSE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define PURO_SSE 1
+#endif
+
+#ifndef PURO_SSE
+    #define PURO_SSE 0
+#endif
+
+#if PURO_SSE
+    #include <emmintrin.h>
+#endif
+
+#if !defined(PURO_F16C) && (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))
+    #define PURO_F16C 1
+#endif
+
+#ifndef PURO_F16C
+    #define PURO_F16C 0
+#endif
+
+#if PURO_F16C
+    #include <immintrin.h>
+#endif
+
+/********************************************
+ ** Loop unrolling
+ *******************************************/
+
+/** Fully unroll the following loop, for loops with a compile-time trip count */
+#if !defined(PURO_UNROLL)
+    #if defined(__clang__)
+        #define PURO_UNROLL _Pragma("clang loop unroll(full)")
+    #elif defined(__GNUC__)
+        #define PURO_UNROLL _Pragma("GCC unroll 128")
+    #else
+        #define PURO_UNROLL
+    #endif
+#endif
+
 /********************************************
  ** void defintions as fallback
  *******************************************/
@@ -0,0 +1,80 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Scoped flush-to-zero and denormals-are-zero mode for the calling thread.
+
+ Decaying tails and feedback paths drift into subnormal floats, which most x86 cores process with microcode
+ assists that are 10-100 times slower than normal arithmetic. With the guard in place, subnormal results are
+ flushed to zero and subnormal inputs are read as zero. The previous mode is restored on destruction.
+
+ The mode is per thread, so it should be set at the entry of every block on the audio thread, and on every worker
+ thread that processes audio. worker_pool and the convolver worker threads apply it for their whole lifetime.
+ Uses MXCSR on SSE targets and FPCR.FZ on AArch64, which has no separate DAZ bit. Elsewhere it does nothing.
+ */
+struct denormal_guard
+{
+    denormal_guard() noexcept
+    {
+#if PURO_SSE
+        previous = _mm_getcsr();
+        _mm_setcsr(previous | ftz_daz_bits);
+#elif defined(__aarch64__) && defined(__GNUC__)
+        uint64_t fpcr;
+        asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+        previous = fpcr;
+        asm volatile("msr fpcr, %0" : : "r"(fpcr | fz_bit));
+#endif
+    }
+
+    ~denormal_guard() noexcept
+    {
+#if PURO_SSE
+        _mm_setcsr(static_cast<unsigned int> (previous));
+#elif defined(__aarch64__) && defined(__GNUC__)
+        asm volatile("msr fpcr, %0" : : "r"(previous));
+#endif
+    }
+
+    denormal_guard (const denormal_guard&) = delete;
+    denormal_guard& operator= (const denormal_guard&) = delete;
+
+    /** True if subnormal results are flushed to zero on the calling thread */
+    static bool is_enabled() noexcept
+    {
+#if PURO_SSE
+        return (_mm_getcsr() & ftz_daz_bits) == ftz_daz_bits;
+#elif defined(__aarch64__) && defined(__GNUC__)
+        uint64_t fpcr;
+        asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+        return (fpcr & fz_bit) != 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+
+    static constexpr unsigned int ftz_daz_bits = 0x8040; // FTZ (bit 15) | DAZ (bit 6)
+    static constexpr uint64_t fz_bit = 1ull << 24;
+
+    uint64_t previous = 0;
+};
+
+namespace math {
+
+/** Tiny offset added inside denormal-safe recursions, keeps their state out of the subnormal range at -360 dB */
+template <typename FloatType>
+constexpr FloatType denormal_offset = static_cast<FloatType> (1e-18);
+
+/** Zero if x is subnormal */
+template <typename FloatType>
+inline FloatType flush_denormal (FloatType x) noexcept
+{
+    return (std::abs(x) < std::numeric_limits<FloatType>::min()) ? 0 : x;
+}
+
+} // namespace math
+
+} // namespace puro
@@ -0,0 +1,252 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Lazy expressions over buffers, evaluated in a single pass on assignment.
+
+ Arithmetic on buffers doesn't compute anything, a * b + c * gain builds a tree of small value types holding the
+ channel pointers. Assigning the tree with dst += ..., dst -= ..., dst *= ... or assign(dst, ...) evaluates it per
+ sample, four samples at a time with SSE when the destination and every buffer in the expression are float, so
+ there are no temporaries and every buffer is read once. Mixed float and double buffers are evaluated in the wider
+ type with the scalar loop. Operands are buffer, fixed_buffer and dynamic_buffer of the same length, and scalars.
+ A mono operand is broadcast to all channels, as in buffer_operations.hpp. The destination may also appear in the
+ expression.
+ */
+
+struct expr_op_assign
+{
+    template <typename T> static T apply (T, T b) noexcept { return b; }
+};
+
+struct expr_op_add
+{
+    template <typename T> static T apply (T a, T b) noexcept { return a + b; }
+#if PURO_SSE
+    static __m128 apply (__m128 a, __m128 b) noexcept { return _mm_add_ps(a, b); }
+#endif
+};
+
+struct expr_op_substract
+{
+    template <typename T> static T apply (T a, T b) noexcept { return a - b; }
+#if PURO_SSE
+    static __m128 apply (__m128 a, __m128 b) noexcept { return _mm_sub_ps(a, b); }
+#endif
+};
+
+struct expr_op_multiply
+{
+    template <typename T> static T apply (T a, T b) noexcept { return a * b; }
+#if PURO_SSE
+    static __m128 apply (__m128 a, __m128 b) noexcept { return _mm_mul_ps(a, b); }
+#endif
+};
+
+/** Leaf referring to a buffer, bound to one channel for evaluation */
+template <typename BT>
+struct expr_buffer
+{
+    typedef typename BT::value_type value_type;
+
+    struct bound
+    {
+        const value_type* ptr;
+
+        value_type operator() (int i) const noexcept { return ptr[i]; }
+#if PURO_SSE
+        __m128 packet (int i) const noexcept { return _mm_loadu_ps(&ptr[i]); }
+#endif
+    };
+
+    bound bind (int ch) const { return { buffer.channel(buffer.num_channels() == 1 ? 0 : ch) }; }
+
+    int length() const { return buffer.length(); }
+    int num_channels() const { return buffer.num_channels(); }
+
+    static constexpr bool is_scalar = false;
+    static constexpr bool is_float = std::is_same<value_type, float>::value;
+
+    BT buffer;
+};
+
+/** Leaf with a constant value, has no length or channels of its own */
+template <typename T>
+struct expr_scalar
+{
+    typedef T value_type;
+
+    struct bound
+    {
+        T value;
+#if PURO_SSE
+        __m128 broadcast;
+#endif
+
+        T operator() (int) const noexcept { return value; }
+#if PURO_SSE
+        __m128 packet (int) const noexcept { return broadcast; }
+#endif
+    };
+
+    bound bind (int) const
+    {
+#if PURO_SSE
+        return { value, _mm_set1_ps(static_cast<float> (value)) };
+#else
+        return { value };
+#endif
+    }
+
+    int length() const { return -1; }
+    int num_channels() const { return 0; }
+
+    static constexpr bool is_scalar = true;
+    static constexpr bool is_float = true; // converted to the type of the buffers
+
+    T value;
+};
+
+template <typename Op, typename L, typename R>
+struct expr_binary
+{
+    // scalars take the sample type of the buffers they're combined with, mixed buffer types are promoted
+    typedef typename std::conditional<L::is_scalar, typename R::value_type,
+            typename std::conditional<R::is_scalar, typename L::value_type,
+            typename std::common_type<typename L::value_type, typename R::value_type>::type>::type>::type value_type;
+
+    struct bound
+    {
+        typename L::bound l;
+        typename R::bound r;
+
+        value_type operator() (int i) const noexcept { return Op::apply(static_cast<value_type> (l(i)), static_cast<value_type> (r(i))); }
+#if PURO_SSE
+        __m128 packet (int i) const noexcept { return Op::apply(l.packet(i), r.packet(i)); }
+#endif
+    };
+
+    bound bind (int ch) const { return { l.bind(ch), r.bind(ch) }; }
+
+    int length() const { return l.length() >= 0 ? l.length() : r.length(); }
+    int num_channels() const { return math::max(l.num_channels(), r.num_channels()); }
+
+    static constexpr bool is_scalar = false;
+    static constexpr bool is_float = L::is_float && R::is_float;
+
+    L l;
+    R r;
+};
+
+/** Operand traits: buffers and expressions take part in expressions, scalars only next to them */
+template <typename T, typename = void>
+struct is_expr_buffer { static constexpr bool value = false; };
+
+template <typename T>
+struct is_expr_buffer <T, typename enable_if_buffer<T, void>::type> { static constexpr bool value = true; };
+
+template <typename T>
+struct is_expr_node { static constexpr bool value = false; };
+
+template <typename Op, typename L, typename R>
+struct is_expr_node <expr_binary<Op, L, R>> { static constexpr bool value = true; };
+
+template <typename T>
+struct is_expr_operand { static constexpr bool value = is_expr_buffer<T>::value || is_expr_node<T>::value || std::is_arithmetic<T>::value; };
+
+template <typename L, typename R>
+using enable_if_expr_operands = typename std::enable_if<is_expr_operand<L>::value && is_expr_operand<R>::value
+                                                        && ! (std::is_arithmetic<L>::value && std::is_arithmetic<R>::value), int>::type;
+
+/** Term type of an operand: buffers are wrapped, integers become float scalars */
+template <typename T, typename = void>
+struct expr_term_type { typedef expr_buffer<T> type; };
+
+template <typename Op, typename L, typename R>
+struct expr_term_type <expr_binary<Op, L, R>> { typedef expr_binary<Op, L, R> type; };
+
+template <typename T>
+struct expr_term_type <T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    typedef expr_scalar<typename std::conditional<std::is_floating_point<T>::value, T, float>::type> type;
+};
+
+template <typename T>
+inline typename expr_term_type<T>::type make_expr_term (const T& operand)
+{
+    if constexpr (is_expr_node<T>::value)
+        return operand;
+    else if constexpr (std::is_arithmetic<T>::value)
+        return { static_cast<typename expr_term_type<T>::type::value_type> (operand) };
+    else
+        return { operand };
+}
+
+template <typename Op, typename L, typename R>
+inline expr_binary<Op, typename expr_term_type<L>::type, typename expr_term_type<R>::type> make_expr (const L& l, const R& r)
+{
+    return { make_expr_term(l), make_expr_term(r) };
+}
+
+template <typename L, typename R, enable_if_expr_operands<L, R> = 0>
+inline auto operator+ (const L& l, const R& r) { return make_expr<expr_op_add>(l, r); }
+
+template <typename L, typename R, enable_if_expr_operands<L, R> = 0>
+inline auto operator- (const L& l, const R& r) { return make_expr<expr_op_substract>(l, r); }
+
+template <typename L, typename R, enable_if_expr_operands<L, R> = 0>
+inline auto operator* (const L& l, const R& r) { return make_expr<expr_op_multiply>(l, r); }
+
+/** dst = Op(dst, e) for every sample in a single pass */
+template <typename Op, typename BT, typename E>
+inline void evaluate (BT dst, const E& operand)
+{
+    typedef typename BT::value_type T;
+    const auto e = make_expr_term(operand);
+
+    errorif(e.length() >= 0 && e.length() != dst.length(), "expression and dst lengths don't match");
+    errorif(e.num_channels() > 1 && e.num_channels() != dst.num_channels(), "channel configs not compatible");
+
+    const int n = dst.length();
+
+    for (int ch = 0; ch < dst.num_channels(); ++ch)
+    {
+        T* d = dst.channel(ch);
+        const auto b = e.bind(ch);
+        int i = 0;
+
+#if PURO_SSE
+        if constexpr (std::is_same<T, float>::value && decltype(e)::is_float)
+        {
+            for (; i + 4 <= n; i += 4)
+            {
+                if constexpr (std::is_same<Op, expr_op_assign>::value)
+                    _mm_storeu_ps(&d[i], b.packet(i));
+                else
+                    _mm_storeu_ps(&d[i], Op::apply(_mm_loadu_ps(&d[i]), b.packet(i)));
+            }
+        }
+#endif
+
+        for (; i < n; ++i)
+            d[i] = Op::apply(d[i], static_cast<T> (b(i)));
+    }
+}
+
+template <typename BT, typename E>
+inline typename std::enable_if<is_expr_buffer<BT>::value && is_expr_operand<E>::value>::type
+assign (BT dst, const E& e) { evaluate<expr_op_assign>(dst, e); }
+
+template <typename BT, typename E>
+inline typename std::enable_if<is_expr_buffer<BT>::value && is_expr_operand<E>::value>::type
+operator+= (BT dst, const E& e) { evaluate<expr_op_add>(dst, e); }
+
+template <typename BT, typename E>
+inline typename std::enable_if<is_expr_buffer<BT>::value && is_expr_operand<E>::value>::type
+operator-= (BT dst, const E& e) { evaluate<expr_op_substract>(dst, e); }
+
+template <typename BT, typename E>
+inline typename std::enable_if<is_expr_buffer<BT>::value && is_expr_operand<E>::value>::type
+operator*= (BT dst, const E& e) { evaluate<expr_op_multiply>(dst, e); }
+
+} // namespace puro
@@ -0,0 +1,187 @@
+#pragma once
+
+#if defined(__linux__)
+    #include <sched.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <cstdio>
+#endif
+
+namespace puro {
+
+/** Size of the huge pages requested by huge_page_allocator */
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+/** NUMA node that huge_page_allocator binds memory allocated on the calling thread to, -1 for no binding */
+inline int& numa_thread_node() noexcept
+{
+    thread_local int node = -1;
+    return node;
+}
+
+/**
+ Run the calling thread on the CPUs of a NUMA node, and bind the memory it allocates with huge_page_allocator to
+ the node, so worker threads can own the sample data of their voices. Returns false if the node doesn't exist or
+ the affinity can't be set, in which case only the memory binding is applied. Linux only, elsewhere returns false.
+ */
+inline bool numa_bind_thread (int node)
+{
+    numa_thread_node() = node;
+
+#if defined(__linux__)
+    char path [64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    FILE* file = std::fopen(path, "r");
+    if (file == nullptr)
+        return false;
+
+    // cpulist is a comma-separated list of cpus and ranges, e.g. 0-3,8-11
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    int first, last;
+    while (std::fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        int c = std::fgetc(file);
+
+        if (c == '-')
+        {
+            if (std::fscanf(file, "%d", &last) != 1)
+                break;
+            c = std::fgetc(file);
+        }
+
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, &cpus);
+
+        if (c != ',')
+            break;
+    }
+
+    std::fclose(file);
+    return CPU_COUNT(&cpus) > 0 && sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ Allocator for large sample data, to be used with heap_block, which places all channels in a single allocation.
+
+ Allocations of at least half a huge page are rounded up to whole 2 MiB pages, so the data of a voice takes a
+ few TLB entries instead of hundreds. On Linux explicit huge pages (MAP_HUGETLB) are tried first, falling back to
+ a 2 MiB aligned mapping with transparent huge pages requested through madvise. If numa_bind_thread() has been
+ called on the allocating thread, the pages are bound to its node with a preferred policy, so the kernel still
+ falls back to other nodes when the node is full. Pages are not touched here, so they are placed on first touch.
+
+ Smaller allocations and other platforms use 64-byte aligned operator new.
+ */
+template <typename T = float>
+struct huge_page_allocator
+{
+    typedef T value_type;
+
+    huge_page_allocator() noexcept = default;
+
+    template <typename U>
+    huge_page_allocator(const huge_page_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n, const void* hint = 0)
+    {
+        const size_t num_bytes = sizeof(T) * n;
+
+#if defined(__linux__)
+        if (num_bytes >= huge_page_size / 2)
+        {
+            const size_t mapped_bytes = round_to_pages(num_bytes);
+
+            void* ptr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if (ptr == MAP_FAILED)
+                ptr = map_aligned(mapped_bytes);
+
+            if (ptr == nullptr)
+                throw std::bad_alloc();
+
+            bind_to_thread_node(ptr, mapped_bytes);
+            return reinterpret_cast<T*> (ptr);
+        }
+#endif
+
+        return reinterpret_cast<T*> (::operator new(num_bytes, std::align_val_t(64)));
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept
+    {
+        const size_t num_bytes = sizeof(T) * n;
+
+#if defined(__linux__)
+        if (num_bytes >= huge_page_size / 2)
+        {
+            munmap(ptr, round_to_pages(num_bytes));
+            return;
+        }
+#endif
+
+        ::operator delete(ptr, std::align_val_t(64));
+    }
+
+    template <typename U>
+    bool operator== (const huge_page_allocator<U>&) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!= (const huge_page_allocator<U>&) const noexcept { return false; }
+
+private:
+
+    static size_t round_to_pages(size_t num_bytes) noexcept
+    {
+        return (num_bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    }
+
+#if defined(__linux__)
+    /** Map with a huge page of slack and unmap the unaligned ends, so the kernel can back it with transparent huge pages */
+    static void* map_aligned(size_t num_bytes) noexcept
+    {
+        void* mapped = mmap(nullptr, num_bytes + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+            return nullptr;
+
+        char* begin = reinterpret_cast<char*> (mapped);
+        char* aligned = reinterpret_cast<char*> ((reinterpret_cast<uintptr_t> (begin) + huge_page_size - 1) & ~(huge_page_size - 1));
+        char* end = begin + num_bytes + huge_page_size;
+
+        if (aligned > begin)
+            munmap(begin, aligned - begin);
+
+        if (end > aligned + num_bytes)
+            munmap(aligned + num_bytes, end - (aligned + num_bytes));
+
+    #if defined(MADV_HUGEPAGE)
+        madvise(aligned, num_bytes, MADV_HUGEPAGE);
+    #endif
+
+        return aligned;
+    }
+
+    static void bind_to_thread_node(void* ptr, size_t num_bytes) noexcept
+    {
+    #if defined(SYS_mbind)
+        const int node = numa_thread_node();
+        if (node < 0 || node >= 64)
+            return;
+
+        const unsigned long mpol_preferred = 1;
+        const unsigned long node_mask = 1ul << node;
+
+        // without libnuma, failure leaves the default policy
+        syscall(SYS_mbind, ptr, num_bytes, mpol_preferred, &node_mask, 64ul, 0u);
+    #endif
+    }
+#endif
+};
+
+} // namespace puro
@@ -55,34 +55,38 @@ std::tuple<AlignmentType, PositionType> interp_avoid_out_of_bounds_reads(Alignme
 }
 
 /** Assumes that the source buffer can provide all the required samples, i.e. doesn't do bound checking.
-    Buffer should be cropped for example with interp_crop_buffer before-hand. */
+    Buffer should be cropped for example with interp_crop_buffer before-hand.
+    The source can also hold float16 or bfloat16 samples, which are converted while reading. */
 template <typename BufferType, typename SourceBufferType, typename PositionType>
 PositionType interp1_fill(BufferType buffer, SourceBufferType source, const PositionType readPos, const PositionType increment) noexcept
 {
     using FloatType = typename BufferType::value_type;
 
-    errorif((buffer.getNumChannels() != source.getNumChannels())
-        && (source.getNumChannels() != 1),
+    errorif((buffer.num_channels() != source.num_channels())
+        && (source.num_channels() != 1),
         "channel configuration not implemented");
 
-    auto position = readPos;
+    PositionType position = readPos;
 
     // identical channel config
-    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    for (int ch = 0; ch < buffer.num_channels(); ++ch)
     {
         //SeqType chSeq = seq;
-        auto position = readPos;
+        position = readPos;
 
         auto dst = buffer.channel(ch);
-        auto src = source.channel(ch);
+        auto src = source.channel(source.num_channels() == 1 ? 0 : ch);
 
         for (int i = 0; i < buffer.length(); ++i)
         {
             const int index = static_cast<int> (position);
-            position += increment;
             const FloatType fract = static_cast<FloatType>(position - index);
+            position += increment;
 
-            dst[i] = src[index] * (1 - fract) + src[index + 1] * fract;
+            FloatType x [2];
+            math::load_taps<2>(x, &src[index]);
+
+            dst[i] = x[0] * (1 - fract) + x[1] * fract;
         }
     }
 
@@ -90,7 +94,8 @@ PositionType interp1_fill(BufferType buffer, SourceBufferType source, const Posi
 }
 
 /** Assumes that the source buffer can provide all the required samples, i.e. doesn't do bound checking.
-    Buffer should be cropped for example with interp_crop_buffer before-hand. */
+    Buffer should be cropped for example with interp_crop_buffer before-hand.
+    The source can also hold float16 or bfloat16 samples, which are converted while reading. */
 template <typename BufferType, typename SourceBufferType, typename PositionType>
 PositionType interp3_fill(BufferType buffer, SourceBufferType source, const PositionType readPos, const PositionType increment) noexcept
 {
@@ -108,15 +113,17 @@ PositionType interp3_fill(BufferType buffer, SourceBufferType source, const Posi
         position = readPos;
 
         auto dst = buffer.channel(ch);
-        auto src = source.channel(ch);
+        auto src = source.channel(source.num_channels() == 1 ? 0 : ch);
 
         for (int i = 0; i < buffer.length(); ++i)
         {
             const int index = static_cast<int> (position);
-            position += increment;
             const FloatType fract = static_cast<FloatType>(position - index);
+            position += increment;
+
+            FloatType x [4];
+            math::load_taps<4>(x, &src[index-1]);
 
-            const FloatType* x = &src[index-1];
             dst[i] = x[1] + fract * (x[2]-x[1]- static_cast<FloatType>(0.1666667) * (1-fract)
                     * ( (x[3]-x[0] - 3.0f*(x[2]-x[1]))*fract
                       + (x[3] + 2*x[0] - 3*x[1])));
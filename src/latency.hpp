@@ -0,0 +1,225 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Log-bucketed histogram of durations in nanoseconds, in the spirit of HdrHistogram.
+ Each power of two is split into 2^(SubBucketBits-1) linear buckets, so a bucket is at most 2^-(SubBucketBits-1)
+ of its lower bound wide. Percentiles are reported as bucket upper bounds, which overestimate the true value by
+ up to that much: 6.25% with the default of 5 bits. Values below 2^SubBucketBits are exact.
+
+ Meant to be written from a single thread (the audio thread) and read from any other thread.
+ Writes are plain relaxed stores without locks or read-modify-write operations, reads are relaxed loads,
+ so a reader may see a snapshot that is a few values behind but never blocks the writer.
+ */
+template <int SubBucketBits = 5, int MaxBits = 40>
+struct latency_histogram
+{
+    static constexpr int sub_bucket_count = 1 << SubBucketBits;
+    static constexpr int half_count = sub_bucket_count / 2;
+    static constexpr int num_buckets = (MaxBits - SubBucketBits + 2) * half_count;
+
+    latency_histogram() { reset(); }
+
+    static int highest_bit (uint64_t value) noexcept
+    {
+        int msb = 0;
+        while (value >>= 1)
+            ++msb;
+        return msb;
+    }
+
+    static int bucket_index (uint64_t value) noexcept
+    {
+        if (value < sub_bucket_count)
+            return static_cast<int> (value);
+
+        const int octave = highest_bit(value) - SubBucketBits + 1;
+        const int index = octave * half_count + static_cast<int> (value >> octave);
+
+        return index < num_buckets ? index : num_buckets - 1;
+    }
+
+    /** Smallest value that falls into the bucket */
+    static uint64_t bucket_lower_bound (int index) noexcept
+    {
+        if (index < sub_bucket_count)
+            return static_cast<uint64_t> (index);
+
+        const int octave = index / half_count - 1;
+        const uint64_t mantissa = static_cast<uint64_t> (index - octave * half_count);
+        return mantissa << octave;
+    }
+
+    /** Largest value that falls into the bucket */
+    static uint64_t bucket_upper_bound (int index) noexcept
+    {
+        return bucket_lower_bound(index + 1) - 1;
+    }
+
+    /** Record a value. Only a single thread should call this. */
+    void record (uint64_t value) noexcept
+    {
+        auto& bucket = counts[bucket_index(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (value > maximum.load(std::memory_order_relaxed))
+            maximum.store(value, std::memory_order_relaxed);
+
+        total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const noexcept { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const noexcept { return maximum.load(std::memory_order_relaxed); }
+
+    /** Value below which the given fraction of recorded values fall, e.g. 0.99 for p99. Returns the upper bound of the bucket. */
+    uint64_t percentile (double fraction) const noexcept
+    {
+        const uint64_t n = count();
+        if (n == 0)
+            return 0;
+
+        const uint64_t target = static_cast<uint64_t> (std::ceil(fraction * static_cast<double> (n)));
+        const uint64_t maxval = max();
+
+        uint64_t sum = 0;
+        for (int i = 0; i < num_buckets; ++i)
+        {
+            sum += counts[i].load(std::memory_order_relaxed);
+            if (sum >= target && sum > 0)
+                return math::min(bucket_upper_bound(i), maxval);
+        }
+
+        return maxval;
+    }
+
+    /** Not safe to call while the writer is recording */
+    void reset() noexcept
+    {
+        for (auto& c : counts)
+            c.store(0, std::memory_order_relaxed);
+
+        maximum.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts [num_buckets];
+    std::atomic<uint64_t> maximum;
+    std::atomic<uint64_t> total;
+};
+
+
+/**
+ Measures the processing time of each audio block against the real-time deadline.
+ The audio thread calls record() or uses a scoped_block_timer once per block, any other thread
+ can read the counters and percentiles at any time without locking.
+ */
+struct xrun_detector
+{
+    typedef std::chrono::steady_clock clock;
+
+    struct summary
+    {
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t p999;
+        uint64_t max;
+        uint64_t num_blocks;
+        uint64_t num_misses;
+        uint64_t deadline;
+    };
+
+    xrun_detector() : deadline_ns(0), misses(0), consecutive_misses(0), longest_miss_streak(0) {}
+
+    xrun_detector (int block_length, double sample_rate) : xrun_detector()
+    {
+        set_deadline(block_length, sample_rate);
+    }
+
+    /** The time available for a block of given length, i.e. block_length / sample_rate */
+    void set_deadline (int block_length, double sample_rate) noexcept
+    {
+        errorif(sample_rate <= 0, "sample rate should be positive");
+        set_deadline_ns(static_cast<uint64_t> (1e9 * block_length / sample_rate));
+    }
+
+    void set_deadline_ns (uint64_t ns) noexcept
+    {
+        deadline_ns.store(ns, std::memory_order_relaxed);
+    }
+
+    /** Record the processing time of a single block. Only the audio thread should call this. */
+    void record (uint64_t ns) noexcept
+    {
+        histogram.record(ns);
+
+        if (ns > deadline_ns.load(std::memory_order_relaxed))
+        {
+            misses.store(misses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+            const uint64_t streak = consecutive_misses.load(std::memory_order_relaxed) + 1;
+            consecutive_misses.store(streak, std::memory_order_relaxed);
+
+            if (streak > longest_miss_streak.load(std::memory_order_relaxed))
+                longest_miss_streak.store(streak, std::memory_order_relaxed);
+        }
+        else
+        {
+            consecutive_misses.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record (clock::time_point start, clock::time_point end) noexcept
+    {
+        record(static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+    }
+
+    uint64_t num_blocks() const noexcept { return histogram.count(); }
+    uint64_t num_misses() const noexcept { return misses.load(std::memory_order_relaxed); }
+    uint64_t longest_streak() const noexcept { return longest_miss_streak.load(std::memory_order_relaxed); }
+    uint64_t deadline() const noexcept { return deadline_ns.load(std::memory_order_relaxed); }
+
+    summary get_summary() const noexcept
+    {
+        return {
+            histogram.percentile(0.5),
+            histogram.percentile(0.99),
+            histogram.percentile(0.999),
+            histogram.max(),
+            num_blocks(),
+            num_misses(),
+            deadline()
+        };
+    }
+
+    /** Not safe to call while the audio thread is recording */
+    void reset() noexcept
+    {
+        histogram.reset();
+        misses.store(0, std::memory_order_relaxed);
+        consecutive_misses.store(0, std::memory_order_relaxed);
+        longest_miss_streak.store(0, std::memory_order_relaxed);
+    }
+
+    latency_histogram<> histogram;
+    std::atomic<uint64_t> deadline_ns;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> consecutive_misses;
+    std::atomic<uint64_t> longest_miss_streak;
+};
+
+/** Records the lifetime of the scope to an xrun_detector, place at the top of the block callback */
+struct scoped_block_timer
+{
+    scoped_block_timer (xrun_detector& d) noexcept : detector(d), start(xrun_detector::clock::now()) {}
+
+    ~scoped_block_timer() noexcept
+    {
+        detector.record(start, xrun_detector::clock::now());
+    }
+
+    xrun_detector& detector;
+    xrun_detector::clock::time_point start;
+};
+
+} // namespace puro
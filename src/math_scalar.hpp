@@ -81,5 +81,141 @@ bool equal(FloatType f1, FloatType f2, const FloatType epsilon=1e-5)
     return (abs(f1-f2) < epsilon);
 }
 
+/** Selects between the standard library functions and the faster approximations below */
+enum class accuracy
+{
+    exact,
+    fast
+};
+
+/**
+ Branch-free atan2 approximation, the vector version is in math_vector.hpp.
+ Max error about 1.2e-5 radians, atan2(0, 0) is 0.
+ */
+template <typename FloatType>
+inline FloatType fast_atan2(FloatType y, FloatType x) noexcept
+{
+    const FloatType ax = std::abs(x);
+    const FloatType ay = std::abs(y);
+    const FloatType mx = ax > ay ? ax : ay;
+    const FloatType mn = ax > ay ? ay : ax;
+
+    // atan on [0, 1], Abramowitz & Stegun 4.4.47
+    const FloatType a = mn / (mx > std::numeric_limits<FloatType>::min() ? mx : std::numeric_limits<FloatType>::min());
+    const FloatType s = a * a;
+    FloatType r = a * (static_cast<FloatType> (0.9998660) + s * (static_cast<FloatType> (-0.3302995)
+                    + s * (static_cast<FloatType> (0.1801410) + s * (static_cast<FloatType> (-0.0851330)
+                    + s * static_cast<FloatType> (0.0208351)))));
+
+    r = (ay > ax) ? static_cast<FloatType> (pi / 2) - r : r;
+    r = (x < 0) ? static_cast<FloatType> (pi) - r : r;
+    return std::copysign(r, y);
+}
+
+/**
+ Branch-free sine and cosine approximation, the vector version is in math_vector.hpp.
+ Reduces to a quarter period around zero and evaluates Taylor polynomials, max error about 5e-7 for |x| < 1000.
+ */
+template <typename FloatType>
+inline void fast_sincos(FloatType x, FloatType& sin_out, FloatType& cos_out) noexcept
+{
+    const FloatType two_over_pi = static_cast<FloatType> (0.636619772367581343);
+    const int q = static_cast<int> (x * two_over_pi + (x >= 0 ? static_cast<FloatType> (0.5) : static_cast<FloatType> (-0.5)));
+
+    // pi/2 split in two parts to keep the reduction accurate
+    const FloatType qf = static_cast<FloatType> (q);
+    const FloatType r = (x - qf * static_cast<FloatType> (1.5703125)) - qf * static_cast<FloatType> (4.83826794897e-4);
+    const FloatType r2 = r * r;
+
+    const FloatType sr = r * (1 + r2 * (static_cast<FloatType> (-1.0 / 6) + r2 * (static_cast<FloatType> (1.0 / 120)
+                       + r2 * static_cast<FloatType> (-1.0 / 5040))));
+    const FloatType cr = 1 + r2 * (static_cast<FloatType> (-0.5) + r2 * (static_cast<FloatType> (1.0 / 24)
+                       + r2 * (static_cast<FloatType> (-1.0 / 720) + r2 * static_cast<FloatType> (1.0 / 40320))));
+
+    const FloatType s = (q & 1) ? cr : sr;
+    const FloatType c = (q & 1) ? sr : cr;
+
+    sin_out = (q & 2) ? -s : s;
+    cos_out = ((q + 1) & 2) ? -c : c;
+}
+
+/** Bit pattern of a float */
+inline uint32_t float_bits(float value) noexcept
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float float_from_bits(uint32_t bits) noexcept
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ IEEE 754 half precision from float, rounded to nearest even. Overflow gives infinity and NaNs stay NaN.
+ Half has 11 bits of precision and a range of about 6e-8 to 65504, plenty for storing magnitudes or samples.
+ */
+inline uint16_t float_to_half(float value) noexcept
+{
+    uint32_t f = float_bits(value);
+    const uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint32_t h;
+    if (f >= 0x47800000u) // inf or nan
+    {
+        h = (f > 0x7f800000u) ? 0x7e00u : 0x7c00u;
+    }
+    else if (f < 0x38800000u) // subnormal or zero, the float addition does the rounding
+    {
+        h = float_bits(float_from_bits(f) + 0.5f) - 0x3f000000u;
+    }
+    else
+    {
+        const uint32_t mantissa_odd = (f >> 13) & 1;
+        f += 0xc8000fffu + mantissa_odd; // rebias exponent by -112 and round
+        h = f >> 13;
+    }
+
+    return static_cast<uint16_t> (h | (sign >> 16));
+}
+
+/** bfloat16 from float, the upper 16 bits rounded to nearest even. NaNs stay NaN. */
+inline uint16_t float_to_bfloat16(float value) noexcept
+{
+    const uint32_t f = float_bits(value);
+
+    if ((f & 0x7fffffffu) > 0x7f800000u)
+        return static_cast<uint16_t> ((f >> 16) | 0x40u);
+
+    return static_cast<uint16_t> ((f + 0x7fffu + ((f >> 16) & 1)) >> 16);
+}
+
+/** Float from bfloat16, exact */
+inline float bfloat16_to_float(uint16_t value) noexcept
+{
+    return float_from_bits(static_cast<uint32_t> (value) << 16);
+}
+
+/** Float from IEEE 754 half precision, exact */
+inline float half_to_float(uint16_t value) noexcept
+{
+    const uint32_t shifted_exponent = 0x7c00u << 13;
+
+    uint32_t f = (value & 0x7fffu) << 13;
+    const uint32_t exponent = f & shifted_exponent;
+    f += (127 - 15) << 23;
+
+    if (exponent == shifted_exponent) // inf or nan
+        f += (128 - 16) << 23;
+    else if (exponent == 0) // subnormal or zero, renormalised with a float subtraction
+        f = float_bits(float_from_bits(f + (1 << 23)) - float_from_bits(113u << 23));
+
+    return float_from_bits(f | (static_cast<uint32_t> (value & 0x8000u) << 16));
+}
+
 } // namespace math
 } // namespace puro
@@ -1,5 +1,31 @@
 #pragma once
 
+namespace puro {
+template <int NumChannels, typename T>
+struct unordered_spectrum;
+
+template <typename T>
+struct is_unordered_spectrum;
+
+/** Packed little-endian 24-bit sample as stored in files, 3 bytes without padding */
+struct int24
+{
+    uint8_t bytes [3];
+};
+
+/** IEEE 754 half precision sample stored as its bits, 11 bits of precision, for compact source material */
+struct float16
+{
+    uint16_t bits;
+};
+
+/** bfloat16 sample, the upper half of a float: the range of float with 8 bits of precision */
+struct bfloat16
+{
+    uint16_t bits;
+};
+}
+
 /** Maths routines, mostly for buffers. Used to allow flexibility later on by implementing vector math libs such as IPP */
 namespace puro {
 namespace math {
@@ -216,6 +242,129 @@ inline void normalise_energy(FloatType* buf, const int n) noexcept
             buf[i] /= sum;
     }
 }
+
+/** Set subnormal values to zero, e.g. for the state of feedback paths at block boundaries */
+inline void flush_denormals(float* buf, const int n) noexcept
+{
+    int i = 0;
+
+#if PURO_SSE
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 smallest = _mm_set1_ps(std::numeric_limits<float>::min());
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(&buf[i]);
+        const __m128 normal = _mm_cmpge_ps(_mm_and_ps(x, abs_mask), smallest);
+        _mm_storeu_ps(&buf[i], _mm_and_ps(x, normal));
+    }
+#endif
+
+    for (; i < n; ++i)
+        buf[i] = flush_denormal(buf[i]);
+}
+
+inline void flush_denormals(double* buf, const int n) noexcept
+{
+    for (int i = 0; i < n; ++i)
+        buf[i] = flush_denormal(buf[i]);
+}
+
+/**
+ One-pole lowpass y[i] = y[i-1] + coeff * (x[i] - y[i-1]), starting from and returning the state y[-1].
+ dst and src can be the same. Once the input goes silent the state decays into subnormals, unless DenormalSafe
+ is set, which adds denormal_offset to the input so the state settles at that offset instead.
+ */
+template <bool DenormalSafe = false, typename FloatType>
+inline FloatType one_pole(FloatType* dst, const FloatType* src, const FloatType coeff, FloatType state, const int n) noexcept
+{
+    const FloatType offset = DenormalSafe ? denormal_offset<FloatType> : 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+        state += coeff * (src[i] + offset - state);
+        dst[i] = state;
+    }
+
+    return state;
+}
+
+/*
+ Fixed-length kernels, for buffers with the length as a template parameter. The trip count is known at compile
+ time, so the loops are fully unrolled and lengths divisible by the vector width vectorise without remainder loops.
+ */
+
+template <int N, typename TDst, typename TSrc>
+inline void copy(TDst* RESTRICT dst, const TSrc* RESTRICT src) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        dst[i] = src[i];
+}
+
+template <int N, typename FloatType>
+inline void clear(FloatType* buf) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        buf[i] = 0;
+}
+
+template <int N, typename FloatType>
+inline void add(FloatType* RESTRICT dst, const FloatType* RESTRICT src) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        dst[i] += src[i];
+}
+
+template <int N, typename FloatType>
+inline void add(FloatType* buf, const FloatType value) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        buf[i] += value;
+}
+
+template <int N, typename FloatType>
+inline void substract(FloatType* RESTRICT dst, const FloatType* RESTRICT src) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        dst[i] -= src[i];
+}
+
+template <int N, typename FloatType>
+inline void multiply(FloatType* RESTRICT dst, const FloatType* RESTRICT src) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        dst[i] *= src[i];
+}
+
+template <int N, typename FloatType>
+inline void multiply(FloatType* buf, const FloatType value) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        buf[i] *= value;
+}
+
+template <int N, typename FloatType>
+inline void multiply_add(FloatType* RESTRICT dst, const FloatType* RESTRICT src1, const FloatType* RESTRICT src2) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        dst[i] += src1[i] * src2[i];
+}
+
+template <int N, typename FloatType>
+inline void multiply_add(FloatType* RESTRICT dst, const FloatType* RESTRICT src, const FloatType value) noexcept
+{
+    PURO_UNROLL
+    for (int i = 0; i < N; ++i)
+        dst[i] += src[i] * value;
+}
     
 // COMPLEX
     
@@ -250,43 +399,845 @@ inline void complex_multiply(T* RESTRICT dst, const T* RESTRICT src1, const T* R
     }
 }
     
+#if PURO_SSE
+
+/** Four-wide fast_atan2 */
+inline __m128 fast_atan2(__m128 y, __m128 x) noexcept
+{
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    const __m128 ax = _mm_andnot_ps(sign_mask, x);
+    const __m128 ay = _mm_andnot_ps(sign_mask, y);
+    const __m128 mx = _mm_max_ps(ax, ay);
+    const __m128 mn = _mm_min_ps(ax, ay);
+
+    const __m128 a = _mm_div_ps(mn, _mm_max_ps(mx, _mm_set1_ps(std::numeric_limits<float>::min())));
+    const __m128 s = _mm_mul_ps(a, a);
+
+    __m128 r = _mm_add_ps(_mm_set1_ps(-0.0851330f), _mm_mul_ps(s, _mm_set1_ps(0.0208351f)));
+    r = _mm_add_ps(_mm_set1_ps(0.1801410f), _mm_mul_ps(s, r));
+    r = _mm_add_ps(_mm_set1_ps(-0.3302995f), _mm_mul_ps(s, r));
+    r = _mm_add_ps(_mm_set1_ps(0.9998660f), _mm_mul_ps(s, r));
+    r = _mm_mul_ps(a, r);
+
+    const __m128 swapped = _mm_cmpgt_ps(ay, ax);
+    r = _mm_or_ps(_mm_and_ps(swapped, _mm_sub_ps(_mm_set1_ps(static_cast<float> (pi / 2)), r)), _mm_andnot_ps(swapped, r));
+
+    const __m128 negative_x = _mm_cmplt_ps(x, _mm_setzero_ps());
+    r = _mm_or_ps(_mm_and_ps(negative_x, _mm_sub_ps(_mm_set1_ps(static_cast<float> (pi)), r)), _mm_andnot_ps(negative_x, r));
+
+    // r is positive, take the sign of y
+    return _mm_or_ps(r, _mm_and_ps(y, sign_mask));
+}
+
+/** Four-wide fast_sincos */
+inline void fast_sincos(__m128 x, __m128& sin_out, __m128& cos_out) noexcept
+{
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+
+    // round half away from zero to the nearest quarter period
+    const __m128 half = _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(x, sign_mask));
+    const __m128i q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.636619772367581343f)), half));
+    const __m128 qf = _mm_cvtepi32_ps(q);
+
+    const __m128 r = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(1.5703125f))), _mm_mul_ps(qf, _mm_set1_ps(4.83826794897e-4f)));
+    const __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 sr = _mm_add_ps(_mm_set1_ps(1.0f / 120), _mm_mul_ps(r2, _mm_set1_ps(-1.0f / 5040)));
+    sr = _mm_add_ps(_mm_set1_ps(-1.0f / 6), _mm_mul_ps(r2, sr));
+    sr = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, sr));
+    sr = _mm_mul_ps(r, sr);
+
+    __m128 cr = _mm_add_ps(_mm_set1_ps(-1.0f / 720), _mm_mul_ps(r2, _mm_set1_ps(1.0f / 40320)));
+    cr = _mm_add_ps(_mm_set1_ps(1.0f / 24), _mm_mul_ps(r2, cr));
+    cr = _mm_add_ps(_mm_set1_ps(-0.5f), _mm_mul_ps(r2, cr));
+    cr = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, cr));
+
+    const __m128 swapped = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+    const __m128 s = _mm_or_ps(_mm_and_ps(swapped, cr), _mm_andnot_ps(swapped, sr));
+    const __m128 c = _mm_or_ps(_mm_and_ps(swapped, sr), _mm_andnot_ps(swapped, cr));
+
+    // bit 1 of the quadrant moved to the sign bit
+    const __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two), 30));
+    const __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), two), 30));
+
+    sin_out = _mm_xor_ps(s, sin_sign);
+    cos_out = _mm_xor_ps(c, cos_sign);
+}
+
+#endif // PURO_SSE
+
+/** Magnitudes of n interleaved complex values */
+inline void complex_magnitudes(float* RESTRICT dst, const float* RESTRICT src, const int n) noexcept
+{
+    int i = 0;
+
+#if PURO_SSE
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 a = _mm_loadu_ps(&src[2*i]);
+        const __m128 b = _mm_loadu_ps(&src[2*i+4]);
+        const __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(&dst[i], _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        const float re = src[2*i];
+        const float im = src[2*i+1];
+        dst[i] = std::sqrt(re * re + im * im);
+    }
+}
+
+/** Phases of n interleaved complex values */
+template <accuracy Accuracy = accuracy::exact>
+inline void complex_phases(float* RESTRICT dst, const float* RESTRICT src, const int n) noexcept
+{
+    int i = 0;
+
+    if constexpr (Accuracy == accuracy::fast)
+    {
+#if PURO_SSE
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 a = _mm_loadu_ps(&src[2*i]);
+            const __m128 b = _mm_loadu_ps(&src[2*i+4]);
+            const __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(&dst[i], fast_atan2(im, re));
+        }
+#endif
+        for (; i < n; ++i)
+            dst[i] = fast_atan2(src[2*i+1], src[2*i]);
+    }
+    else
+    {
+        for (; i < n; ++i)
+            dst[i] = std::atan2(src[2*i+1], src[2*i]);
+    }
+}
+
+/** n interleaved complex values from magnitudes and phases */
+template <accuracy Accuracy = accuracy::exact>
+inline void complex_from_polar(float* RESTRICT dst, const float* RESTRICT magnitudes, const float* RESTRICT phases, const int n) noexcept
+{
+    int i = 0;
+
+    if constexpr (Accuracy == accuracy::fast)
+    {
+#if PURO_SSE
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 s, c;
+            fast_sincos(_mm_loadu_ps(&phases[i]), s, c);
+
+            const __m128 m = _mm_loadu_ps(&magnitudes[i]);
+            const __m128 re = _mm_mul_ps(c, m);
+            const __m128 im = _mm_mul_ps(s, m);
+
+            _mm_storeu_ps(&dst[2*i], _mm_unpacklo_ps(re, im));
+            _mm_storeu_ps(&dst[2*i+4], _mm_unpackhi_ps(re, im));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            float s, c;
+            fast_sincos(phases[i], s, c);
+            dst[2*i] = c * magnitudes[i];
+            dst[2*i+1] = s * magnitudes[i];
+        }
+    }
+    else
+    {
+        for (; i < n; ++i)
+        {
+            dst[2*i] = std::cos(phases[i]) * magnitudes[i];
+            dst[2*i+1] = std::sin(phases[i]) * magnitudes[i];
+        }
+    }
+}
+
+#if PURO_SSE
+namespace interleave_detail {
+
+template <bool Add>
+FORCE_INLINE void store4 (float* dst, __m128 v) noexcept
+{
+    _mm_storeu_ps(dst, Add ? _mm_add_ps(_mm_loadu_ps(dst), v) : v);
+}
+
+/** Store the lower or upper two floats of v */
+template <bool Add, bool High>
+FORCE_INLINE void store2 (float* dst, __m128 v) noexcept
+{
+    __m64* p = reinterpret_cast<__m64*> (dst);
+
+    if (Add)
+    {
+        const __m128 d = High ? _mm_loadh_pi(_mm_setzero_ps(), p) : _mm_loadl_pi(_mm_setzero_ps(), p);
+        v = _mm_add_ps(v, d);
+    }
+
+    if (High)
+        _mm_storeh_pi(p, v);
+    else
+        _mm_storel_pi(p, v);
+}
+
+/** Interleave 4 samples of NumChannels channels, which is 2, 4, 6 or 8 */
+template <int NumChannels, bool Add>
+FORCE_INLINE void interleave4 (float* dst, const float* const* src, int i) noexcept
+{
+    if (NumChannels == 2)
+    {
+        const __m128 a = _mm_loadu_ps(&src[0][i]);
+        const __m128 b = _mm_loadu_ps(&src[1][i]);
+        store4<Add>(dst, _mm_unpacklo_ps(a, b));
+        store4<Add>(dst + 4, _mm_unpackhi_ps(a, b));
+        return;
+    }
+
+    // channels 0-3 and 4-7 as two transposes, frames are 4 samples after each other
+    for (int group = 0; group + 4 <= NumChannels; group += 4)
+    {
+        __m128 r0 = _mm_loadu_ps(&src[group][i]);
+        __m128 r1 = _mm_loadu_ps(&src[group + 1][i]);
+        __m128 r2 = _mm_loadu_ps(&src[group + 2][i]);
+        __m128 r3 = _mm_loadu_ps(&src[group + 3][i]);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        store4<Add>(dst + group, r0);
+        store4<Add>(dst + group + NumChannels, r1);
+        store4<Add>(dst + group + 2 * NumChannels, r2);
+        store4<Add>(dst + group + 3 * NumChannels, r3);
+    }
+
+    if (NumChannels == 6)
+    {
+        const __m128 a = _mm_loadu_ps(&src[4][i]);
+        const __m128 b = _mm_loadu_ps(&src[5][i]);
+        const __m128 lo = _mm_unpacklo_ps(a, b);
+        const __m128 hi = _mm_unpackhi_ps(a, b);
+
+        store2<Add, false>(dst + 4, lo);
+        store2<Add, true>(dst + 10, lo);
+        store2<Add, false>(dst + 16, hi);
+        store2<Add, true>(dst + 22, hi);
+    }
+}
+
+/** Deinterleave 4 frames of NumChannels channels, which is 2, 4, 6 or 8 */
+template <int NumChannels, bool Add>
+FORCE_INLINE void deinterleave4 (float* const* dst, const float* src, int i) noexcept
+{
+    if (NumChannels == 2)
+    {
+        const __m128 a = _mm_loadu_ps(src);
+        const __m128 b = _mm_loadu_ps(src + 4);
+        store4<Add>(&dst[0][i], _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        store4<Add>(&dst[1][i], _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        return;
+    }
+
+    for (int group = 0; group + 4 <= NumChannels; group += 4)
+    {
+        __m128 r0 = _mm_loadu_ps(src + group);
+        __m128 r1 = _mm_loadu_ps(src + group + NumChannels);
+        __m128 r2 = _mm_loadu_ps(src + group + 2 * NumChannels);
+        __m128 r3 = _mm_loadu_ps(src + group + 3 * NumChannels);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        store4<Add>(&dst[group][i], r0);
+        store4<Add>(&dst[group + 1][i], r1);
+        store4<Add>(&dst[group + 2][i], r2);
+        store4<Add>(&dst[group + 3][i], r3);
+    }
+
+    if (NumChannels == 6)
+    {
+        const __m64* p = reinterpret_cast<const __m64*> (src);
+        const __m128 f01 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), p + 2), p + 5);
+        const __m128 f23 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), p + 8), p + 11);
+
+        store4<Add>(&dst[4][i], _mm_shuffle_ps(f01, f23, _MM_SHUFFLE(2, 0, 2, 0)));
+        store4<Add>(&dst[5][i], _mm_shuffle_ps(f01, f23, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+}
+
+} // namespace interleave_detail
+#endif
+
+/** n frames of planar channels to interleaved frames. dst = src or with Add, dst += src */
+template <int NumChannels, bool Add = false>
+inline void interleave(float* RESTRICT dst, const float* const* src, const int n) noexcept
+{
+    int i = 0;
+
+#if PURO_SSE
+    if constexpr (NumChannels == 2 || NumChannels == 4 || NumChannels == 6 || NumChannels == 8)
+    {
+        for (; i + 4 <= n; i += 4)
+            interleave_detail::interleave4<NumChannels, Add>(&dst[i * NumChannels], src, i);
+    }
+#endif
+
+    for (; i < n; ++i)
+        for (int ch = 0; ch < NumChannels; ++ch)
+            dst[i * NumChannels + ch] = Add ? dst[i * NumChannels + ch] + src[ch][i] : src[ch][i];
+}
+
+/** n interleaved frames to planar channels. dst = src or with Add, dst += src */
+template <int NumChannels, bool Add = false>
+inline void deinterleave(float* const* dst, const float* RESTRICT src, const int n) noexcept
+{
+    int i = 0;
+
+#if PURO_SSE
+    if constexpr (NumChannels == 2 || NumChannels == 4 || NumChannels == 6 || NumChannels == 8)
+    {
+        for (; i + 4 <= n; i += 4)
+            interleave_detail::deinterleave4<NumChannels, Add>(dst, &src[i * NumChannels], i);
+    }
+#endif
+
+    for (; i < n; ++i)
+        for (int ch = 0; ch < NumChannels; ++ch)
+            dst[ch][i] = Add ? dst[ch][i] + src[i * NumChannels + ch] : src[i * NumChannels + ch];
+}
+
+/** Noise added before rounding to integer formats, in units of the least significant bit */
+enum class dither
+{
+    none,
+    rectangular,    // uniform in [-0.5, 0.5)
+    triangular      // sum of two uniforms in (-1, 1), decorrelates the error from the signal
+};
+
+/** Xorshift32 noise source for dithering, with four lanes for the vectorised kernels */
+struct dither_noise
+{
+    dither_noise(uint32_t seed = 1)
+    {
+        for (int i = 0; i < 4; ++i)
+            state[i] = (seed + 0x9e3779b9u * (i + 1)) | 1u;
+    }
+
+    /** Uniform in [0, 1) from the first lane */
+    float uniform()
+    {
+        uint32_t x = state[0];
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        state[0] = x;
+        return float_from_bits((x >> 9) | 0x3f800000u) - 1.0f;
+    }
+
+    template <dither Dither>
+    float next()
+    {
+        if (Dither == dither::triangular)
+            return uniform() - uniform();
+
+        return (Dither == dither::rectangular) ? uniform() - 0.5f : 0.0f;
+    }
+
+#if PURO_SSE
+    __m128 uniform4()
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*> (state));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        _mm_storeu_si128(reinterpret_cast<__m128i*> (state), x);
+
+        const __m128i mantissa = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+        return _mm_sub_ps(_mm_castsi128_ps(mantissa), _mm_set1_ps(1.0f));
+    }
+
+    template <dither Dither>
+    __m128 next4()
+    {
+        if (Dither == dither::triangular)
+            return _mm_sub_ps(uniform4(), uniform4());
+
+        return (Dither == dither::rectangular) ? _mm_sub_ps(uniform4(), _mm_set1_ps(0.5f)) : _mm_setzero_ps();
+    }
+#endif
+
+    uint32_t state [4];
+};
+
+/**
+ Full scale and the largest value of the integer sample formats. Floats in [-1, 1) map to the whole integer range,
+ values outside are saturated. For int32 the maximum is the largest float below 2^31.
+ */
+template <typename IntType, typename FloatType> struct sample_format {};
+
+template <typename FloatType> struct sample_format<int16_t, FloatType>
+{
+    static constexpr FloatType scale = 32768;
+    static constexpr FloatType max = 32767;
+};
+
+template <typename FloatType> struct sample_format<int24, FloatType>
+{
+    static constexpr FloatType scale = 8388608;
+    static constexpr FloatType max = 8388607;
+};
+
+template <typename FloatType> struct sample_format<int32_t, FloatType>
+{
+    static constexpr FloatType scale = 2147483648.0;
+    static constexpr FloatType max = std::is_same<FloatType, float>::value ? 2147483520.0 : 2147483647.0;
+};
+
+inline int32_t int24_load(const int24& v) noexcept
+{
+    // sign-extended by the arithmetic shift
+    const uint32_t u = (static_cast<uint32_t> (v.bytes[0]) << 8) | (static_cast<uint32_t> (v.bytes[1]) << 16) | (static_cast<uint32_t> (v.bytes[2]) << 24);
+    return static_cast<int32_t> (u) >> 8;
+}
+
+inline void int24_store(int24& dst, int32_t value) noexcept
+{
+    dst.bytes[0] = static_cast<uint8_t> (value);
+    dst.bytes[1] = static_cast<uint8_t> (value >> 8);
+    dst.bytes[2] = static_cast<uint8_t> (value >> 16);
+}
+
+#if PURO_SSE
+namespace sample_format_detail {
+
+/** Four integer samples as sign-extended int32 lanes. int24 reads 16 bytes, so 6 samples should be readable. */
+inline __m128i load4(const int16_t* src) noexcept
+{
+    const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*> (src));
+    return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+inline __m128i load4(const int32_t* src) noexcept
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*> (src));
+}
+
+inline __m128i load4(const int24* src) noexcept
+{
+    // move each sample to the bottom of its own register, gather the bottom lanes, and sign-extend from 24 bits
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*> (src));
+    const __m128i s01 = _mm_unpacklo_epi32(x, _mm_srli_si128(x, 3));
+    const __m128i s23 = _mm_unpacklo_epi32(_mm_srli_si128(x, 6), _mm_srli_si128(x, 9));
+    return _mm_srai_epi32(_mm_slli_epi32(_mm_unpacklo_epi64(s01, s23), 8), 8);
+}
+
+/** Store four int32 lanes, which should already be in the range of the format */
+inline void store4(int16_t* dst, __m128i x) noexcept
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i*> (dst), _mm_packs_epi32(x, x));
+}
+
+inline void store4(int32_t* dst, __m128i x) noexcept
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*> (dst), x);
+}
+
+inline void store4(int24* dst, __m128i x) noexcept
+{
+    // pack pairs of 24-bit values into the low 48 bits of each 64-bit lane, then join the two lanes into 12 bytes
+    const __m128i low = _mm_and_si128(x, _mm_set_epi32(0, 0xffffff, 0, 0xffffff));
+    const __m128i high = _mm_and_si128(_mm_srli_epi64(x, 8), _mm_set_epi32(0xffff, static_cast<int> (0xff000000), 0xffff, static_cast<int> (0xff000000)));
+    const __m128i pairs = _mm_or_si128(low, high);
+    const __m128i packed = _mm_or_si128(_mm_move_epi64(pairs), _mm_slli_si128(_mm_srli_si128(pairs, 8), 6));
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*> (dst), packed);
+    const int32_t last = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+    std::memcpy(reinterpret_cast<char*> (dst) + 8, &last, 4);
+}
+
+} // namespace sample_format_detail
+#endif
+
+/** Integer samples to float or double, scaled to [-1, 1). Vectorised with SSE2 for all combinations. */
+template <typename FloatType, typename IntType>
+inline void int_to_float(FloatType* RESTRICT dst, const IntType* RESTRICT src, const int n) noexcept
+{
+    const FloatType scale = 1 / sample_format<IntType, FloatType>::scale;
+    int i = 0;
+
+#if PURO_SSE
+    // int24 loads read 16 bytes for 4 samples
+    const int vector_end = std::is_same<IntType, int24>::value ? n - 2 : n;
+
+    for (; i + 4 <= vector_end; i += 4)
+    {
+        const __m128i x = sample_format_detail::load4(&src[i]);
+
+        if constexpr (std::is_same<FloatType, float>::value)
+        {
+            _mm_storeu_ps(&dst[i], _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(scale)));
+        }
+        else
+        {
+            _mm_storeu_pd(&dst[i], _mm_mul_pd(_mm_cvtepi32_pd(x), _mm_set1_pd(scale)));
+            _mm_storeu_pd(&dst[i + 2], _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), _mm_set1_pd(scale)));
+        }
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        if constexpr (std::is_same<IntType, int24>::value)
+            dst[i] = static_cast<FloatType> (int24_load(src[i])) * scale;
+        else
+            dst[i] = static_cast<FloatType> (src[i]) * scale;
+    }
+}
+
+/** Float or double samples to integers with optional dither, rounded to nearest and saturated. Vectorised with SSE2 for all combinations. */
+template <dither Dither = dither::none, typename IntType, typename FloatType>
+inline void float_to_int(IntType* RESTRICT dst, const FloatType* RESTRICT src, const int n, dither_noise* noise = nullptr) noexcept
+{
+    errorif(Dither != dither::none && noise == nullptr, "dithering needs a noise source");
+
+    typedef sample_format<IntType, FloatType> format;
+    int i = 0;
+
+#if PURO_SSE
+    auto to_int = [&](const FloatType* p)
+    {
+        if constexpr (std::is_same<FloatType, float>::value)
+        {
+            __m128 x = _mm_mul_ps(_mm_loadu_ps(p), _mm_set1_ps(format::scale));
+            if (Dither != dither::none)
+                x = _mm_add_ps(x, noise->template next4<Dither>());
+
+            return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-format::scale)), _mm_set1_ps(format::max)));
+        }
+        else
+        {
+            __m128d lo = _mm_mul_pd(_mm_loadu_pd(p), _mm_set1_pd(format::scale));
+            __m128d hi = _mm_mul_pd(_mm_loadu_pd(p + 2), _mm_set1_pd(format::scale));
+
+            if (Dither != dither::none)
+            {
+                const __m128 d = noise->template next4<Dither>();
+                lo = _mm_add_pd(lo, _mm_cvtps_pd(d));
+                hi = _mm_add_pd(hi, _mm_cvtps_pd(_mm_movehl_ps(d, d)));
+            }
+
+            const __m128d low = _mm_set1_pd(-format::scale);
+            const __m128d high = _mm_set1_pd(format::max);
+            lo = _mm_min_pd(_mm_max_pd(lo, low), high);
+            hi = _mm_min_pd(_mm_max_pd(hi, low), high);
+
+            return _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+        }
+    };
+
+    for (; i + 4 <= n; i += 4)
+        sample_format_detail::store4(&dst[i], to_int(&src[i]));
+#endif
+
+    for (; i < n; ++i)
+    {
+        FloatType x = src[i] * format::scale;
+        if (Dither != dither::none)
+            x += static_cast<FloatType> (noise->template next<Dither>());
+
+        x = std::nearbyint(clip(x, -format::scale, format::max));
+
+        if constexpr (std::is_same<IntType, int24>::value)
+            int24_store(dst[i], static_cast<int32_t> (x));
+        else
+            dst[i] = static_cast<IntType> (x);
+    }
+}
+
+/** Convert to half precision, see float_to_half() */
+inline void float_to_half(uint16_t* RESTRICT dst, const float* RESTRICT src, const int n) noexcept
+{
+    int i = 0;
+
+#if PURO_F16C
+    for (; i + 4 <= n; i += 4)
+        _mm_storel_epi64(reinterpret_cast<__m128i*> (&dst[i]), _mm_cvtps_ph(_mm_loadu_ps(&src[i]), _MM_FROUND_TO_NEAREST_INT));
+#endif
+
+    for (; i < n; ++i)
+        dst[i] = float_to_half(src[i]);
+}
+
+/** Convert from half precision, see half_to_float() */
+inline void half_to_float(float* RESTRICT dst, const uint16_t* RESTRICT src, const int n) noexcept
+{
+    int i = 0;
+
+#if PURO_F16C
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(&dst[i], _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*> (&src[i]))));
+#endif
+
+    for (; i < n; ++i)
+        dst[i] = half_to_float(src[i]);
+}
+
+inline void float_to_half(float16* RESTRICT dst, const float* RESTRICT src, const int n) noexcept
+{
+    float_to_half(reinterpret_cast<uint16_t*> (dst), src, n);
+}
+
+inline void half_to_float(float* RESTRICT dst, const float16* RESTRICT src, const int n) noexcept
+{
+    half_to_float(dst, reinterpret_cast<const uint16_t*> (src), n);
+}
+
+inline void float_to_half(bfloat16* RESTRICT dst, const float* RESTRICT src, const int n) noexcept
+{
+    for (int i = 0; i < n; ++i)
+        dst[i].bits = float_to_bfloat16(src[i]);
+}
+
+inline void half_to_float(float* RESTRICT dst, const bfloat16* RESTRICT src, const int n) noexcept
+{
+    for (int i = 0; i < n; ++i)
+        dst[i] = bfloat16_to_float(src[i].bits);
+}
+
+/** Sample value as float, for code that reads any sample type */
+inline float sample_to_float(float x) noexcept { return x; }
+inline double sample_to_float(double x) noexcept { return x; }
+
+inline float sample_to_float(float16 x) noexcept
+{
+#if PURO_F16C
+    return _cvtsh_ss(x.bits);
+#else
+    return half_to_float(x.bits);
+#endif
+}
+
+inline float sample_to_float(bfloat16 x) noexcept { return bfloat16_to_float(x.bits); }
+
+/** N consecutive samples as floats, the interpolator taps. Half precision is converted with one F16C instruction. */
+template <int N, typename FloatType, typename T>
+FORCE_INLINE void load_taps(FloatType* RESTRICT dst, const T* RESTRICT src) noexcept
+{
+#if PURO_F16C
+    if constexpr (std::is_same<T, float16>::value && std::is_same<FloatType, float>::value && (N == 2 || N == 4))
+    {
+        __m128i bits;
+        if constexpr (N == 2)
+        {
+            int32_t pair;
+            std::memcpy(&pair, src, sizeof(pair));
+            bits = _mm_cvtsi32_si128(pair);
+        }
+        else
+        {
+            bits = _mm_loadl_epi64(reinterpret_cast<const __m128i*> (src));
+        }
+
+        alignas(16) float taps [4];
+        _mm_store_ps(taps, _mm_cvtph_ps(bits));
+
+        for (int i = 0; i < N; ++i)
+            dst[i] = taps[i];
+        return;
+    }
+#endif
+
+    for (int i = 0; i < N; ++i)
+        dst[i] = static_cast<FloatType> (sample_to_float(src[i]));
+}
+
+#ifndef PURO_FFT_PLAN_CACHE_CAPACITY
+    #define PURO_FFT_PLAN_CACHE_CAPACITY 64
+#endif
+
+/**
+ Process-wide cache of pffft setups keyed by size and transform type, shared by all math::fft instances and threads.
+ Setups are immutable once created, so any number of threads can transform with the same setup at once.
+
+ Lookups are lock-free. A setup missing from the cache is created under a lock, which allocates, so sizes used on
+ the audio thread should be created in advance with prewarm(). Setups live until the end of the program.
+ get() returns nullptr for sizes pffft doesn't support, and for new sizes once the cache is full.
+
+ Also provides an aligned work buffer per thread, so transforms don't need stack space for large sizes.
+ */
+struct fft_plan_cache
+{
+    static PFFFT_Setup* get (int size, pffft_transform_t type = PFFFT_REAL)
+    {
+        fft_plan_cache& cache = instance();
+        const int key = make_key(size, type);
+
+        const int n = cache.num_entries.load(std::memory_order_acquire);
+        for (int i = 0; i < n; ++i)
+        {
+            if (cache.entries[i].key == key)
+                return cache.entries[i].setup;
+        }
+
+        return cache.insert(size, type);
+    }
+
+    /** Create the setup and reserve the work buffer of the calling thread. Call from every thread that will transform. */
+    static void prewarm (int size, pffft_transform_t type = PFFFT_REAL)
+    {
+        get(size, type);
+        work_buffer(work_buffer_length(size, type));
+    }
+
+    /** Aligned work buffer of the calling thread with at least the given number of floats, only allocates if it needs to grow */
+    static float* work_buffer (int length)
+    {
+        thread_local work_storage storage;
+
+        if (storage.capacity < length)
+            storage.reserve(length);
+
+        return storage.data;
+    }
+
+    static int work_buffer_length (int size, pffft_transform_t type)
+    {
+        return (type == PFFFT_COMPLEX) ? 2 * size : size;
+    }
+
+private:
+
+    struct entry
+    {
+        int key;
+        PFFFT_Setup* setup;
+    };
+
+    struct work_storage
+    {
+        float* data = nullptr;
+        int capacity = 0;
+
+        ~work_storage()
+        {
+            if (data != nullptr)
+                pffft_aligned_free(data);
+        }
+
+        void reserve (int length)
+        {
+            if (data != nullptr)
+                pffft_aligned_free(data);
+
+            data = reinterpret_cast<float*> (pffft_aligned_malloc(sizeof(float) * length));
+            capacity = length;
+        }
+    };
+
+    fft_plan_cache() : num_entries(0) {}
+
+    ~fft_plan_cache()
+    {
+        for (int i = 0; i < num_entries.load(); ++i)
+            pffft_destroy_setup(entries[i].setup);
+    }
+
+    static fft_plan_cache& instance()
+    {
+        static fft_plan_cache cache;
+        return cache;
+    }
+
+    static int make_key (int size, pffft_transform_t type)
+    {
+        return 2 * size + ((type == PFFFT_COMPLEX) ? 1 : 0);
+    }
+
+    PFFFT_Setup* insert (int size, pffft_transform_t type)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+
+        // another thread may have inserted it while we were waiting for the lock
+        const int key = make_key(size, type);
+        const int n = num_entries.load(std::memory_order_relaxed);
+        for (int i = 0; i < n; ++i)
+        {
+            if (entries[i].key == key)
+                return entries[i].setup;
+        }
+
+        errorif(n == PURO_FFT_PLAN_CACHE_CAPACITY, "fft plan cache full, increase PURO_FFT_PLAN_CACHE_CAPACITY");
+        if (n == PURO_FFT_PLAN_CACHE_CAPACITY)
+            return nullptr;
+
+        PFFFT_Setup* setup = pffft_new_setup(size, type);
+        errorif(setup == nullptr, "size not supported by pffft");
+        if (setup == nullptr)
+            return nullptr;
+
+        entries[n].key = key;
+        entries[n].setup = setup;
+
+        // entries are published by the release store and never modified afterwards
+        num_entries.store(n + 1, std::memory_order_release);
+        return setup;
+    }
+
+    entry entries [PURO_FFT_PLAN_CACHE_CAPACITY];
+    std::atomic<int> num_entries;
+    std::mutex mutex;
+};
+
 /** FFT wrapper for pffft. Results are not normalised!
- irfft(rfft(signal)) = fftSize * signal */
+ irfft(rfft(signal)) = fftSize * signal
+ The setup is shared through fft_plan_cache, so constructing doesn't allocate if the size has been prewarmed.
+ If pffft doesn't support the size or the plan cache is full, there is no setup and every transform outputs zeros. */
 struct fft
 {
-    fft(int size) : setup(pffft_new_setup(size, PFFFT_REAL)), fft_size(size)
-    {}
+    fft(int size) : setup(fft_plan_cache::get(size, PFFFT_REAL)), fft_size(size)
+    {
+        errorif(setup == nullptr, "fft size not supported by pffft, or fft plan cache full");
+    }
 
-    ~fft()
+    float* work_buffer() const
     {
-        pffft_destroy_setup(setup);
+        return fft_plan_cache::work_buffer(fft_size);
     }
 
     template <typename BT>
     void rfft(BT buffer)
     {
+        static_assert(! is_unordered_spectrum<BT>::value, "use the unordered_spectrum overloads for spectra in the internal order");
+        float* work = work_buffer();
         for (int ch=0; ch<buffer.num_channels(); ++ch)
         {
-            pffft_transform_ordered(setup, buffer.channel(ch), buffer.channel(ch), 0, PFFFT_FORWARD);
+            transform(buffer.channel(ch), buffer.channel(ch), work, PFFFT_FORWARD, true);
         }
     }
 
     template <typename BT1, typename BT2>
     void rfft(BT1 dst, BT2 src)
     {
+        static_assert(! (is_unordered_spectrum<BT1>::value || is_unordered_spectrum<BT2>::value), "use the unordered_spectrum overloads for spectra in the internal order");
         errorif(dst.num_channels() != src.num_channels(), "number of channels not same");
+        float* work = work_buffer();
         for (int ch=0; ch < dst.num_channels(); ++ch)
         {
-            pffft_transform_ordered(setup, src.channel(ch), dst.channel(ch), 0, PFFFT_FORWARD);
+            transform(src.channel(ch), dst.channel(ch), work, PFFFT_FORWARD, true);
         }
     }
 
     template <typename BT>
     void irfft(BT buffer, bool normalise = true)
     {
+        static_assert(! is_unordered_spectrum<BT>::value, "use the unordered_spectrum overloads for spectra in the internal order");
+        float* work = work_buffer();
         for (int ch=0; ch<buffer.num_channels(); ++ch)
         {
-            pffft_transform_ordered(setup, buffer.channel(ch), buffer.channel(ch), 0, PFFFT_BACKWARD);
+            transform(buffer.channel(ch), buffer.channel(ch), work, PFFFT_BACKWARD, true);
             
             if (normalise)
                 math::multiply(buffer.channel(ch), 1.0f/(float)fft_size, buffer.length());
@@ -297,23 +1248,139 @@ struct fft
     template <typename BT1, typename BT2>
     void irfft(BT1 dst, BT2 src, bool normalise = true)
     {
+        static_assert(! (is_unordered_spectrum<BT1>::value || is_unordered_spectrum<BT2>::value), "use the unordered_spectrum overloads for spectra in the internal order");
         errorif(dst.num_channels() != src.num_channels(), "number of channels not same");
+        float* work = work_buffer();
         for (int ch=0; ch < dst.num_channels(); ++ch)
         {
-            pffft_transform_ordered(setup, src.channel(ch), dst.channel(ch), 0, PFFFT_BACKWARD);
+            transform(src.channel(ch), dst.channel(ch), work, PFFFT_BACKWARD, true);
             
             if (normalise)
                 math::multiply(dst.channel(ch), 1.0f/(float)fft_size, dst.length());
         }
     }
 
+    /** Forward transform to the internal order of pffft, skipping the reordering pass */
+    template <int NumChannels, typename BT>
+    void rfft(unordered_spectrum<NumChannels, float> dst, BT src)
+    {
+        errorif(dst.num_channels() != src.num_channels(), "number of channels not same");
+        float* work = work_buffer();
+        for (int ch=0; ch < dst.num_channels(); ++ch)
+        {
+            transform(src.channel(ch), dst.channel(ch), work, PFFFT_FORWARD, false);
+        }
+    }
+
+    /** Backward transform from the internal order of pffft, skipping the reordering pass */
+    template <typename BT, int NumChannels>
+    void irfft(BT dst, unordered_spectrum<NumChannels, float> src, bool normalise = true)
+    {
+        errorif(dst.num_channels() != src.num_channels(), "number of channels not same");
+        float* work = work_buffer();
+        for (int ch=0; ch < dst.num_channels(); ++ch)
+        {
+            transform(src.channel(ch), dst.channel(ch), work, PFFFT_BACKWARD, false);
+
+            if (normalise)
+                math::multiply(dst.channel(ch), 1.0f/(float)fft_size, dst.length());
+        }
+    }
+
+    /**
+     dst += src1 * src2 * scaling for spectra in the internal order, with the vectorised multiply-accumulate of pffft.
+     src2 may have a single channel, which is then used for all channels.
+     */
+    template <int NumChannels, int NumChannels2>
+    void convolve_accumulate(unordered_spectrum<NumChannels, float> dst,
+                             const unordered_spectrum<NumChannels, float> src1,
+                             const unordered_spectrum<NumChannels2, float> src2,
+                             float scaling = 1.0f)
+    {
+        errorif(dst.length() != fft_size || src1.length() != fft_size || src2.length() != fft_size, "spectrum lengths should equal fft size");
+        static_assert(NumChannels2 == 1 || NumChannels2 == NumChannels, "incompatible channel configs");
+
+        if (setup == nullptr)
+            return;
+
+        for (int ch=0; ch < dst.num_channels(); ++ch)
+        {
+            pffft_zconvolve_accumulate(setup, src1.channel(ch), src2.channel(NumChannels2 == 1 ? 0 : ch), dst.channel(ch), scaling);
+        }
+    }
+
+    /**
+     Batched forward transforms of all channels, ordered or unordered depending on the dst type. With a worker_pool,
+     channels are transformed in parallel if the batch is at least parallel_batch_min_size samples in total, below that
+     waking up the workers costs more than it saves. Each thread uses its own work buffer, so prewarm the size on the
+     pool threads as well if the batch is run on the audio thread.
+
+     Without a pool this is the same per-channel loop as calling rfft() for every channel. Channels aren't interleaved
+     across SIMD lanes, pffft already vectorises within each transform, so the only speedup comes from the threads.
+     */
+    template <typename BT1, typename BT2>
+    void rfft_batch(BT1 dst, BT2 src, worker_pool* pool = nullptr)
+    {
+        errorif(dst.num_channels() != src.num_channels(), "number of channels not same");
+        transform_batch(dst, src, PFFFT_FORWARD, ! is_unordered_spectrum<BT1>::value, 1.0f, pool);
+    }
+
+    /** Batched backward transforms of all channels, see rfft_batch() */
+    template <typename BT1, typename BT2>
+    void irfft_batch(BT1 dst, BT2 src, bool normalise = true, worker_pool* pool = nullptr)
+    {
+        errorif(dst.num_channels() != src.num_channels(), "number of channels not same");
+        const float scale = normalise ? 1.0f / (float)fft_size : 1.0f;
+        transform_batch(dst, src, PFFFT_BACKWARD, ! is_unordered_spectrum<BT2>::value, scale, pool);
+    }
+
     int length() const
     {
         return fft_size;
     }
 
+    /** Transform of a single channel, in the internal order of pffft unless ordered. Zeros if there is no setup. */
+    void transform(const float* src, float* dst, float* work, pffft_direction_t direction, bool ordered) const
+    {
+        if (setup == nullptr)
+            math::clear(dst, fft_size);
+        else if (ordered)
+            pffft_transform_ordered(setup, src, dst, work, direction);
+        else
+            pffft_transform(setup, src, dst, work, direction);
+    }
+
+    static constexpr int parallel_batch_min_size = 1 << 15;
+
     PFFFT_Setup* setup;
     int fft_size;
+
+private:
+
+    template <typename BT1, typename BT2>
+    void transform_batch(BT1 dst, BT2 src, pffft_direction_t direction, bool ordered, float scale, worker_pool* pool)
+    {
+        auto transform_channel = [&](int ch)
+        {
+            float* work = work_buffer();
+
+            transform(src.channel(ch), dst.channel(ch), work, direction, ordered);
+
+            if (scale != 1.0f)
+                math::multiply(dst.channel(ch), scale, fft_size);
+        };
+
+        const int num_channels = dst.num_channels();
+
+        if (pool != nullptr && pool->num_threads() > 0 && num_channels > 1 && num_channels * fft_size >= parallel_batch_min_size)
+        {
+            pool->run(num_channels, transform_channel);
+            return;
+        }
+
+        for (int ch = 0; ch < num_channels; ++ch)
+            transform_channel(ch);
+    }
 };
 
 } // namespace math
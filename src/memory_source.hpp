@@ -1,16 +1,141 @@
 #pragma once
 
+#ifndef PURO_USE_MEMORY_STATS
+    #define PURO_USE_MEMORY_STATS 0
+#endif
+
 namespace puro {
 
+/** Values of memory_stats at one point in time */
+struct memory_stats_snapshot
+{
+    size_t capacity_bytes = 0;
+    size_t bytes_in_use = 0;
+    size_t peak_bytes = 0;
+    size_t padding_bytes = 0;
+    uint64_t num_allocations = 0;
+    uint64_t num_exhaustions = 0;
+
+    /** Share of the capacity in use, 0 if the capacity isn't known */
+    double usage() const { return capacity_bytes > 0 ? static_cast<double> (bytes_in_use) / capacity_bytes : 0.0; }
+
+    /** Share of the bytes in use lost to alignment and padding */
+    double fragmentation() const { return bytes_in_use > 0 ? static_cast<double> (padding_bytes) / bytes_in_use : 0.0; }
+};
+
+/**
+Usage counters of a memory source, enabled with PURO_USE_MEMORY_STATS.
+Written only by the thread that owns the memory source, with plain relaxed stores, and readable from any thread
+at any time with read(). Values read while the owner is allocating may be from slightly different moments.
+Exhaustions are counted also in builds where errorif is a no-op, so a monitoring thread can see them.
+Copies take a snapshot of the counters, so memory sources copy the same way with and without the stats.
+*/
+struct memory_stats
+{
+    memory_stats() = default;
+
+    memory_stats(const memory_stats& other) { *this = other; }
+
+    memory_stats& operator= (const memory_stats& other)
+    {
+        const memory_stats_snapshot values = other.read();
+        store(capacity, values.capacity_bytes);
+        store(in_use, values.bytes_in_use);
+        store(peak, values.peak_bytes);
+        store(padding_in_use, values.padding_bytes);
+        store(allocations, values.num_allocations);
+        store(exhaustions, values.num_exhaustions);
+        return *this;
+    }
+
+    void add_capacity(size_t bytes) { store(capacity, capacity.load(std::memory_order_relaxed) + bytes); }
+
+    /** New memory handed out, padding is included in bytes */
+    void allocated(size_t bytes, size_t padding = 0)
+    {
+        reallocated(in_use.load(std::memory_order_relaxed) + bytes, padding_in_use.load(std::memory_order_relaxed) + padding);
+    }
+
+    /** For sources that hand out the same memory again, the amount in use after the request */
+    void reallocated(size_t bytes, size_t padding = 0)
+    {
+        store(allocations, allocations.load(std::memory_order_relaxed) + 1);
+        released_to(bytes, padding);
+
+        if (bytes > peak.load(std::memory_order_relaxed))
+            store(peak, bytes);
+    }
+
+    /** Memory given back, the amount still in use */
+    void released_to(size_t bytes, size_t padding = 0)
+    {
+        store(in_use, bytes);
+        store(padding_in_use, padding);
+    }
+
+    void exhausted() { store(exhaustions, exhaustions.load(std::memory_order_relaxed) + 1); }
+
+    memory_stats_snapshot read() const
+    {
+        memory_stats_snapshot result;
+        result.capacity_bytes = capacity.load(std::memory_order_relaxed);
+        result.bytes_in_use = in_use.load(std::memory_order_relaxed);
+        result.peak_bytes = peak.load(std::memory_order_relaxed);
+        result.padding_bytes = padding_in_use.load(std::memory_order_relaxed);
+        result.num_allocations = allocations.load(std::memory_order_relaxed);
+        result.num_exhaustions = exhaustions.load(std::memory_order_relaxed);
+        return result;
+    }
+
+private:
+
+    template <typename V>
+    static void store(std::atomic<V>& counter, V value) { counter.store(value, std::memory_order_relaxed); }
+
+    std::atomic<size_t> capacity { 0 };
+    std::atomic<size_t> in_use { 0 };
+    std::atomic<size_t> peak { 0 };
+    std::atomic<size_t> padding_in_use { 0 };
+    std::atomic<uint64_t> allocations { 0 };
+    std::atomic<uint64_t> exhaustions { 0 };
+};
+
+/**
+Stand-in for memory_stats when PURO_USE_MEMORY_STATS is off. The calls compile to nothing, but as an empty member
+it still takes a byte, plus padding to the alignment of the memory source.
+*/
+struct no_memory_stats
+{
+    void add_capacity(size_t) {}
+    void allocated(size_t, size_t = 0) {}
+    void reallocated(size_t, size_t = 0) {}
+    void released_to(size_t, size_t = 0) {}
+    void exhausted() {}
+    memory_stats_snapshot read() const { return memory_stats_snapshot(); }
+};
+
+#if PURO_USE_MEMORY_STATS
+    typedef memory_stats memory_stats_type;
+#else
+    typedef no_memory_stats memory_stats_type;
+#endif
+
 template <int NumChannels, int Length, typename T = float>
 struct stack_block
 {
     typedef T value_type;
 
+    stack_block() { stats.add_capacity(sizeof(data)); }
+
     inline void assign_allocated(T** dst, int num_channels, int length)
     {
         errorif(length > Length, "requested longer channels than was allocated");
 
+        if (length > Length || num_channels > NumChannels)
+            stats.exhausted();
+
+        stats.reallocated(sizeof(T) * num_channels * length);
+
         for (int ch = 0; ch < num_channels; ch++)
         {
             dst[ch] = data[ch];
@@ -18,6 +143,7 @@ struct stack_block
     }
 
     T data[NumChannels][Length];
+    memory_stats_type stats;
 };
 
 
@@ -26,10 +152,17 @@ struct aligned_block
 {
     typedef T value_type;
 
+    aligned_block() { stats.add_capacity(sizeof(data)); }
+
     inline void assign_allocated(T** dst, int num_channels, int length)
     {
         errorif(length > Length, "requested longer channels than was allocated");
 
+        if (length > Length || num_channels > NumChannels)
+            stats.exhausted();
+
+        size_t padding = 0;
+
         for (int ch = 0; ch < num_channels; ch++)
         {
             char* ptr = data[ch];
@@ -37,10 +170,15 @@ struct aligned_block
             size_t remainder = ((size_t)ptr) % Alignment;
             size_t offset = Alignment - remainder;
             dst[ch] = (T*)(ptr + offset);
+
+            padding += offset;
         }
+
+        stats.reallocated(sizeof(T) * num_channels * length + padding, padding);
     }
 
     char data[NumChannels][sizeof(T) * Length + Alignment - 1];
+    memory_stats_type stats;
 };
     
 template <int Capacity, int ExtraPadding, int Alignment = 8, typename T = float>
@@ -48,12 +186,13 @@ struct aligned_fixed_pool
 {
     typedef unsigned char byte;
     
-    inline aligned_fixed_pool() : ptr(data) {}
+    inline aligned_fixed_pool() : ptr(data) { stats.add_capacity(sizeof(data)); }
     
     inline void assign_allocated(T** dst, int num_channels, int length)
     {
         for (int ch = 0; ch < num_channels; ch++)
         {
+            const byte* unaligned = ptr;
             align_ptr(); // ensure that ptr is at correct alignment
             
             const size_t num_bytes_requested = length * sizeof(T);
@@ -61,6 +200,11 @@ struct aligned_fixed_pool
 
             errorif (ptr + num_bytes_requested > data + sizeof(data), "out of bounds");
 
+            if (ptr + num_bytes_requested > data + sizeof(data))
+                stats.exhausted();
+
+            stats.allocated(ptr - unaligned + num_bytes_requested, ptr - unaligned);
+
             dst[ch] = (T*)ptr;
 
             ptr += num_bytes_requested;
@@ -84,13 +228,21 @@ private:
     
     byte data [sizeof(T) * Capacity + (1 + ExtraPadding) * (Alignment - 1)];
     byte* ptr;
+
+public:
+
+    memory_stats_type stats;
 };
 
 
+/**
+Channels are placed one after another in a single allocation, each starting at a 64-byte boundary
+relative to the first, so an allocator can place the whole block on as few pages as possible.
+*/
 template <typename T, typename Allocator>
 struct heap_block
 {
-    heap_block() : num_channels_allocated(-1), num_samples_allocated(-1), ptrs(nullptr) {};
+    heap_block() : num_channels_allocated(-1), num_samples_allocated(-1), stride(0), data(nullptr), ptrs(nullptr) {};
 
     heap_block(int num_channels, int length)
     {
@@ -103,13 +255,10 @@ struct heap_block
         if (ptrs != nullptr)
         {
             Allocator alloc;
-            for (int ch = 0; ch < num_channels_allocated; ++ch)
-            {
-                alloc.deallocate(ptrs[ch], num_samples_allocated);
-            }
+            alloc.deallocate(data, static_cast<size_t> (num_channels_allocated) * stride);
 
             // deallocate index
-            delete ptrs;
+            delete[] ptrs;
         }
     }
 
@@ -127,6 +276,9 @@ struct heap_block
         errorif (num_channels > num_channels_allocated, "max_channels out of range");
         errorif (length > num_samples_allocated, "too much allocated memory requested");
 
+        if (num_channels > num_channels_allocated || length > num_samples_allocated)
+            stats.exhausted();
+
         for (int ch = 0; ch < num_channels; ch++)
         {
             dst[ch] = ptrs[ch];
@@ -135,24 +287,119 @@ struct heap_block
 
     inline void allocate_memory(int num_channels, int num_samples)
     {
-        // allocate index
-        ptrs = new T* [num_channels];
+        // channel stride rounded up to whole cache lines
+        const int line = math::max(1, static_cast<int> (64 / sizeof(T)));
+        stride = (num_samples + line - 1) / line * line;
 
         // allocate the channel data
         Allocator alloc;
+        data = alloc.allocate(static_cast<size_t> (num_channels) * stride);
+
+        // allocate index
+        ptrs = new T* [num_channels];
+
         for (int ch = 0; ch < num_channels; ++ch)
         {
-            ptrs[ch] = alloc.allocate(num_samples);
+            ptrs[ch] = data + static_cast<size_t> (ch) * stride;
         }
 
         num_channels_allocated = num_channels;
         num_samples_allocated = num_samples;
+
+        const size_t num_bytes = sizeof(T) * num_channels * stride;
+        stats.add_capacity(num_bytes);
+        stats.allocated(num_bytes, sizeof(T) * num_channels * (stride - num_samples));
     }
 
     int num_channels_allocated;
     int num_samples_allocated;
+    int stride;
 
+    T* data;
     T** ptrs;
+
+    memory_stats_type stats;
+};
+
+/**
+All channels in one allocation with a stride padded against cache set conflicts.
+With power-of-two lengths, channels that start a multiple of 4 KiB apart map to the same cache sets and alias
+in the store buffer, so kernels that stream several channels at once evict each other. Here the stride is rounded up
+to an odd number of 64-byte cache lines, which puts consecutive channels on different sets for any length.
+Memory is allocated on construction or on the first assign_allocated().
+*/
+template <typename T = float, typename Allocator = math::allocator<T>>
+struct planar_block
+{
+    typedef T value_type;
+
+    static constexpr int cache_line_bytes = 64;
+
+    planar_block() : num_channels_allocated(0), num_samples_allocated(0), stride(0), data(nullptr) {}
+
+    planar_block(int num_channels, int length) : planar_block()
+    {
+        allocate_memory(num_channels, length);
+    }
+
+    ~planar_block()
+    {
+        if (data != nullptr)
+            Allocator().deallocate(data, static_cast<size_t> (num_channels_allocated) * stride);
+    }
+
+    planar_block(const planar_block&) = delete;
+    planar_block& operator= (const planar_block&) = delete;
+
+    inline void assign_allocated(T** dst, int num_channels, int length)
+    {
+        if (data == nullptr)
+            allocate_memory(num_channels, length);
+
+        errorif(num_channels > num_channels_allocated, "max_channels out of range");
+        errorif(length > num_samples_allocated, "too much allocated memory requested");
+
+        if (num_channels > num_channels_allocated || length > num_samples_allocated)
+            stats.exhausted();
+
+        for (int ch = 0; ch < num_channels; ++ch)
+            dst[ch] = data + static_cast<size_t> (ch) * stride;
+    }
+
+    /** Stride in elements for a channel length, an odd number of cache lines */
+    static int padded_stride(int length)
+    {
+        const int line = math::max(1, static_cast<int> (cache_line_bytes / sizeof(T)));
+        int num_lines = (length + line - 1) / line;
+
+        if (num_lines % 2 == 0)
+            ++num_lines;
+
+        return num_lines * line;
+    }
+
+    int num_channels_allocated;
+    int num_samples_allocated;
+    int stride;
+
+    T* data;
+
+    memory_stats_type stats;
+
+private:
+
+    void allocate_memory(int num_channels, int length)
+    {
+        stride = padded_stride(length);
+        data = Allocator().allocate(static_cast<size_t> (num_channels) * stride);
+
+        num_channels_allocated = num_channels;
+        num_samples_allocated = length;
+
+        const size_t num_bytes = sizeof(T) * num_channels * stride;
+        stats.add_capacity(num_bytes);
+        stats.allocated(num_bytes, sizeof(T) * num_channels * (stride - length));
+    }
 };
 
 /**
@@ -183,8 +430,15 @@ public:
     {
         allocate_node_and_push_front();
         head->block.assign_allocated(dst, num_channels, length);
+
+        // the pool grows with every block, so capacity and usage are the same
+        const size_t stride_bytes = sizeof(T) * head->block.stride;
+        stats.add_capacity(num_channels * stride_bytes);
+        stats.allocated(num_channels * stride_bytes, num_channels * (stride_bytes - sizeof(T) * length));
     }
 
+    memory_stats_type stats;
+
 private:
 
     struct linked_node
@@ -209,6 +463,85 @@ private:
 
 
 
+/**
+A bump-pointer arena for temporary buffers that are only needed for the duration of a block.
+Memory is allocated once on construction, assign_allocated() hands out aligned channels from the front of the
+arena and reset() releases all of them at once in O(1). mark() and rewind() release only what was handed out
+after the mark, for nested scopes.
+The high water mark tracks the largest number of bytes in use since construction, to size the arena.
+*/
+template <typename T = float, int Alignment = 16>
+struct scratch_arena
+{
+    typedef T value_type;
+    typedef unsigned char byte;
+
+    scratch_arena(int capacity)
+    : data(new byte [sizeof(T) * capacity + Alignment - 1])
+    , num_bytes(sizeof(T) * capacity)
+    , used(0)
+    , max_used(0)
+    {
+        const size_t remainder = ((size_t)data.get()) % Alignment;
+        begin = data.get() + ((remainder == 0) ? 0 : Alignment - remainder);
+
+        stats.add_capacity(num_bytes);
+    }
+
+    inline void assign_allocated(T** dst, int num_channels, int length)
+    {
+        const size_t channel_bytes = (sizeof(T) * length + Alignment - 1) / Alignment * Alignment;
+
+        errorif(used + num_channels * channel_bytes > num_bytes, "scratch arena out of memory");
+
+        if (used + num_channels * channel_bytes > num_bytes)
+            stats.exhausted();
+
+        stats.allocated(num_channels * channel_bytes, num_channels * (channel_bytes - sizeof(T) * length));
+
+        for (int ch = 0; ch < num_channels; ++ch)
+        {
+            dst[ch] = (T*)(begin + used);
+            used += channel_bytes;
+        }
+
+        max_used = math::max(max_used, used);
+    }
+
+    inline void reset()
+    {
+        used = 0;
+        stats.released_to(0);
+    }
+
+    inline size_t mark() const { return used; }
+
+    inline void rewind(size_t marker)
+    {
+        // padding isn't tracked per mark, the released part is assumed to be padded like the rest
+        const memory_stats_snapshot current = stats.read();
+        const size_t padding = (current.bytes_in_use > 0) ? current.padding_bytes * marker / current.bytes_in_use : 0;
+
+        used = marker;
+        stats.released_to(marker, padding);
+    }
+
+    size_t bytes_used() const { return used; }
+    size_t high_water_mark() const { return max_used; }
+    size_t capacity_bytes() const { return num_bytes; }
+
+    memory_stats_type stats;
+
+private:
+
+    std::unique_ptr<byte[]> data;
+    byte* begin;
+    size_t num_bytes;
+    size_t used;
+    size_t max_used;
+};
+
+
 /**
     Works like std::enable_if. Broadcasts type void if type can be used as a memory source for buffers.
     Partial specialisation for the actual types that we want to support.
@@ -243,6 +576,12 @@ struct enable_if_memory_source<heap_block<T, Allocator> >
     typedef void type;
 };
 
+template <typename T, typename Allocator>
+struct enable_if_memory_source<planar_block<T, Allocator> >
+{
+    typedef void type;
+};
+
 template <typename T, typename Allocator>
 struct enable_if_memory_source<heap_block_pool<T, Allocator> >
 {
@@ -250,4 +589,10 @@ struct enable_if_memory_source<heap_block_pool<T, Allocator> >
 };
 
 
+template <typename T, int Alignment>
+struct enable_if_memory_source<scratch_arena<T, Alignment> >
+{
+    typedef void type;
+};
+
 } // namespace puro
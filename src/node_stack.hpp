@@ -277,6 +277,10 @@ public:
         Chunk* newChunk = new Chunk(numElements);
         newChunk->next.reset(head.release());
 
+        // nodes are handed out to the stack all at once
+        stats.add_capacity(sizeof(Node<T>) * numElements);
+        stats.allocated(sizeof(Node<T>) * numElements);
+
         head.reset(newChunk);
 
         for (Node<T>& node : newChunk->memory)
@@ -285,6 +289,8 @@ public:
         }
     }
 
+    memory_stats_type stats;
+
 private:
     std::unique_ptr<Chunk> head;
 };
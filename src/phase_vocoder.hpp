@@ -0,0 +1,245 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Phase vocoder for time-stretching and pitch-shifting a source buffer in real time.
+
+ Every hop_size output samples a frame is synthesised from the source at the current read position. The source is
+ read with linear interpolation at an increment of pitch, so each frame is already pitch-shifted, and a second
+ frame is read one hop earlier in the resampled time. The phase difference of the two frames gives the phase
+ advance over exactly one synthesis hop, which is why the read position can move at any speed, stop or jump like a
+ grain without disturbing the phases.
+
+ Phases are propagated with identity phase locking (Laroche & Dolson): the phase advance is computed only for
+ spectral peaks, and the bins around each peak keep their analysed phase relation to it. Channels are processed
+ independently. Magnitudes and phases are computed for whole frames with the spectrum.hpp helpers, by default with
+ the vectorised atan2 and sincos approximations, whose phase error of about 1e-5 radians is inaudible.
+
+ Memory is allocated on construction. process() doesn't allocate.
+ */
+template <int NumChannels, math::accuracy Accuracy = math::accuracy::fast>
+struct phase_vocoder
+{
+    typedef buffer<NumChannels, float> buffer_type;
+
+    phase_vocoder (int fft_size, int hop_size)
+    : fft_size(fft_size)
+    , hop_size(hop_size)
+    , num_bins(fft_size / 2 + 1)
+    , transform(fft_size)
+    , frame_memory(2 * NumChannels, fft_size)
+    , spectral_memory(4 * NumChannels, fft_size / 2 + 1)
+    , window_memory(2, fft_size)
+    , output_memory(NumChannels, fft_size + hop_size)
+    , output(fft_size + hop_size, output_memory)
+    , peaks(fft_size / 2 + 1)
+    , hop_position(0)
+    , first_frame(true)
+    {
+        errorif(fft_size <= 0 || fft_size % 32 != 0, "fft size should be a positive multiple of 32");
+        errorif(hop_size <= 0 || hop_size > fft_size, "hop size should be between 1 and fft size");
+
+        float* analysis = window_memory.ptrs[0];
+        float* synthesis = window_memory.ptrs[1];
+
+        // periodic hann, synthesis window normalised by the overlapping squared windows and 1/N of the inverse transform
+        buffer<1> window (fft_size, &window_memory.ptrs[0]);
+        envelope_hann_fill(window, 0.0f, envelope_hann_get_increment<float>(fft_size, false));
+
+        for (int i = 0; i < hop_size; ++i)
+        {
+            float sum = 0;
+            for (int j = i; j < fft_size; j += hop_size)
+                sum += analysis[j] * analysis[j];
+
+            for (int j = i; j < fft_size; j += hop_size)
+                synthesis[j] = (sum > 0) ? analysis[j] / (sum * static_cast<float> (fft_size)) : 0.0f;
+        }
+
+        reset();
+    }
+
+    phase_vocoder (const phase_vocoder&) = delete;
+    phase_vocoder& operator= (const phase_vocoder&) = delete;
+
+    /** Clear the output and start the phases over from the next frame */
+    void reset()
+    {
+        for (int ch = 0; ch < NumChannels; ++ch)
+            math::clear(output.channel(ch), output.length());
+
+        output.index = 0;
+        hop_position = 0;
+        first_frame = true;
+    }
+
+    /**
+     Fill dst from source starting at the read position. The read position advances by speed per output sample,
+     speed can be anything including zero or negative. Pitch is the frequency ratio and should be positive.
+     Parts of frames that fall outside the source are read as silence. Returns the advanced read position.
+     */
+    template <typename BT, typename SourceType>
+    float process (BT dst, SourceType source, float position, float speed, float pitch)
+    {
+        errorif(dst.num_channels() != NumChannels, "dst channel count should equal NumChannels");
+        errorif(source.num_channels() != NumChannels && source.num_channels() != 1, "incompatible source channel config");
+        errorif(pitch <= 0, "pitch should be positive");
+
+        int written = 0;
+        while (written < dst.length())
+        {
+            if (hop_position == 0)
+                process_frame(source, position, pitch);
+
+            const int n = math::min(dst.length() - written, hop_size - hop_position);
+
+            ring_buffer_copy_to_buffer(dst.sub(written, n), output, 0);
+            ring_buffer_clear(output, 0, n);
+            output = ring_buffer_advance_index(output, n);
+
+            position += speed * n;
+            written += n;
+
+            hop_position += n;
+            if (hop_position == hop_size)
+                hop_position = 0;
+        }
+
+        return position;
+    }
+
+    const int fft_size;
+    const int hop_size;
+    const int num_bins;
+
+private:
+
+    buffer_type frame (int index) const { return buffer_type (fft_size, &frame_memory.ptrs[index * NumChannels]); }
+    buffer_type spectral (int index) const { return buffer_type (num_bins, &spectral_memory.ptrs[index * NumChannels]); }
+
+    template <typename SourceType>
+    void process_frame (SourceType source, float position, float pitch)
+    {
+        buffer_type current = frame(0);
+        buffer_type previous = frame(1);
+
+        buffer_type magnitudes = spectral(0);
+        buffer_type current_phases = spectral(1);
+        buffer_type previous_phases = spectral(2);
+        buffer_type synthesis_phases = spectral(3);
+
+        buffer<1> analysis_window (fft_size, &window_memory.ptrs[0]);
+        buffer<1> synthesis_window (fft_size, &window_memory.ptrs[1]);
+
+        read_frame(current, source, position, pitch);
+        read_frame(previous, source, position - hop_size * pitch, pitch);
+
+        multiply(current, analysis_window);
+        multiply(previous, analysis_window);
+
+        transform.rfft(current);
+        transform.rfft(previous);
+
+        spectrum_magnitudes(magnitudes, current);
+        spectrum_phases<Accuracy>(current_phases, current);
+
+        if (first_frame)
+        {
+            copy(synthesis_phases, current_phases);
+            first_frame = false;
+        }
+        else
+        {
+            spectrum_phases<Accuracy>(previous_phases, previous);
+
+            for (int ch = 0; ch < NumChannels; ++ch)
+            {
+                lock_phases(synthesis_phases.channel(ch), magnitudes.channel(ch),
+                            current_phases.channel(ch), previous_phases.channel(ch));
+            }
+        }
+
+        spectrum_from_polar<Accuracy>(current, magnitudes, synthesis_phases);
+        transform.irfft(current, false);
+        multiply(current, synthesis_window);
+
+        ring_buffer_add_from_buffer(output, current, 0);
+    }
+
+    /** Interpolated read of a whole frame, the part outside the source is cleared */
+    template <typename SourceType>
+    void read_frame (buffer_type dst, SourceType source, float position, float increment)
+    {
+        const float last = static_cast<float> (source.length() - 2);
+
+        const int i0 = math::max(0, static_cast<int> (std::ceil(-position / increment)));
+        const int i1 = math::min(fft_size, static_cast<int> (std::floor((last - position) / increment)) + 1);
+
+        if (i1 <= i0)
+        {
+            dst.clear();
+            return;
+        }
+
+        clear(dst.sub(0, i0));
+        interp1_fill(dst.sub(i0, i1 - i0), source, position + i0 * increment, increment);
+        clear(dst.sub(i1, fft_size - i1));
+    }
+
+    static float wrap_phase (float phase)
+    {
+        return phase - 2 * math::pi * std::floor((phase + math::pi) / (2 * math::pi));
+    }
+
+    /** Advance the synthesis phases of the peaks by their analysed phase difference, and lock the other bins to the nearest peak */
+    void lock_phases (float* synthesis, const float* magnitudes, const float* current, const float* previous)
+    {
+        const int nq = num_bins - 1;
+
+        int num_peaks = 0;
+        for (int k = 1; k < nq; ++k)
+        {
+            if (magnitudes[k] > magnitudes[k - 1] && magnitudes[k] >= magnitudes[k + 1])
+                peaks[num_peaks++] = k;
+        }
+
+        if (num_peaks == 0)
+        {
+            for (int k = 1; k < nq; ++k)
+                synthesis[k] = wrap_phase(synthesis[k] + current[k] - previous[k]);
+        }
+
+        for (int i = 0; i < num_peaks; ++i)
+        {
+            const int peak = peaks[i];
+            const int start = (i == 0) ? 1 : (peaks[i - 1] + peak) / 2 + 1;
+            const int end = (i == num_peaks - 1) ? nq - 1 : (peak + peaks[i + 1]) / 2;
+
+            const float peak_phase = wrap_phase(synthesis[peak] + current[peak] - previous[peak]);
+            const float rotation = peak_phase - current[peak];
+
+            for (int k = start; k <= end; ++k)
+                synthesis[k] = wrap_phase(current[k] + rotation);
+        }
+
+        // DC and Nyquist are real
+        synthesis[0] = current[0];
+        synthesis[nq] = current[nq];
+    }
+
+    math::fft transform;
+
+    heap_block<float, math::allocator<float>> frame_memory;
+    heap_block<float, math::allocator<float>> spectral_memory;
+    heap_block<float, math::allocator<float>> window_memory;
+    heap_block<float, math::allocator<float>> output_memory;
+
+    ring_buffer<NumChannels> output;
+    std::vector<int> peaks;
+
+    int hop_position;
+    bool first_frame;
+};
+
+} // namespace puro
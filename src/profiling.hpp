@@ -1,14 +1,56 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <list>
 #include <map>
+#include <thread>
 
-#include "purolib.hpp"
+#include "puro.hpp"
 #include "plot.hpp"
 
-#define PURO_USE_TRACE 0
-#define PURO_USE_PROFILE 1
+#ifndef PURO_USE_TRACE
+    #define PURO_USE_TRACE 0
+#endif
+
+#ifndef PURO_USE_PROFILE
+    #define PURO_USE_PROFILE 1
+#endif
+
+/** Time profile scopes with the CPU cycle counter instead of steady_clock */
+#ifndef PURO_PROFILE_USE_TSC
+    #define PURO_PROFILE_USE_TSC 0
+#endif
+
+/** Record hardware counters per profile scope, Linux only */
+#ifndef PURO_PROFILE_USE_PERF
+    #define PURO_PROFILE_USE_PERF 0
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define PURO_HAS_TSC 1
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+    #define PURO_HAS_CNTVCT 1
+#endif
+
+#if PURO_PROFILE_USE_PERF
+    #if !defined(__linux__)
+        #error "PURO_PROFILE_USE_PERF requires Linux perf_event_open"
+    #endif
+    #include <cstring>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
 
 namespace puro {
     
@@ -26,6 +68,299 @@ buffer<NumChannels, T> make_buffer (std::vector<T>& vector)
 } // namespace puro
 
 
+/**
+ Writes events in the Chrome trace event JSON format, to be opened in chrome://tracing or ui.perfetto.dev.
+ Timestamps are microseconds since the steady_clock epoch, so trace and profile events written by the same process
+ line up. With PURO_PROFILE_USE_TSC, profile events are converted from TSC ticks to that epoch through the anchor
+ taken at calibration, so they line up to within the drift of the measured tick rate.
+ */
+struct ChromeTraceWriter
+{
+    typedef std::chrono::time_point<std::chrono::steady_clock> time_point;
+
+    ChromeTraceWriter (const char* path) : file (path), num_events (0)
+    {
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    }
+
+    ~ChromeTraceWriter()
+    {
+        file << "\n]}\n";
+    }
+
+    bool is_open() const { return file.is_open(); }
+
+    void thread_name (int tid, const char* name)
+    {
+        begin_event();
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+             << ",\"args\":{\"name\":\"";
+        write_escaped (name);
+        file << " " << tid << "\"}}";
+    }
+
+    /** Span with start and duration, nesting is inferred by the viewer from the spans of the same tid */
+    void complete (const char* name, const char* category, int tid, time_point start, time_point end, int depth)
+    {
+        complete (name, category, tid, to_micros (start), std::chrono::duration<double, std::micro> (end - start).count(), depth);
+    }
+
+    /** Span with start and duration in microseconds, with optional extra integer arguments shown in the viewer */
+    void complete (const char* name, const char* category, int tid, double start_micros, double duration_micros, int depth,
+                   const char* const* arg_names = nullptr, const uint64_t* arg_values = nullptr, int num_args = 0)
+    {
+        begin_event();
+        file << "{\"name\":\"";
+        write_escaped (name);
+        file << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+             << ",\"ts\":" << start_micros
+             << ",\"dur\":" << duration_micros
+             << ",\"args\":{\"depth\":" << depth;
+
+        for (int i=0; i<num_args; ++i)
+            file << ",\"" << arg_names[i] << "\":" << arg_values[i];
+
+        file << "}}";
+    }
+
+    /** Single point in time, scoped to its thread */
+    void instant (const char* name, const char* category, int tid, time_point time)
+    {
+        begin_event();
+        file << "{\"name\":\"";
+        write_escaped (name);
+        file << "\",\"cat\":\"" << category << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":" << tid
+             << ",\"ts\":" << to_micros (time) << "}";
+    }
+
+private:
+
+    void begin_event()
+    {
+        if (num_events++ > 0)
+            file << ",\n";
+    }
+
+    void write_escaped (const char* str)
+    {
+        for (; str != nullptr && *str != 0; ++str)
+        {
+            if (*str == '"' || *str == '\\')
+                file << '\\';
+            file << *str;
+        }
+    }
+
+public:
+
+    static double to_micros (time_point t)
+    {
+        return std::chrono::duration<double, std::micro> (t.time_since_epoch()).count();
+    }
+
+private:
+
+    std::ofstream file;
+    int num_events;
+};
+
+
+/**
+ Reads the CPU timestamp counter directly, which costs a few nanoseconds instead of the
+ tens of nanoseconds of a steady_clock call. The tick rate is calibrated against steady_clock once, which blocks
+ for 20 ms: ProfileThread::register_thread() and ProfileFrame::start_collecting() do it, so it happens on
+ initialisation and never inside profiled code.
+ Falls back to steady_clock nanoseconds on platforms without an accessible cycle counter.
+ */
+struct TscClock
+{
+    typedef uint64_t ticks;
+
+    static ticks now()
+    {
+#if PURO_HAS_TSC
+        return __rdtsc();
+#elif PURO_HAS_CNTVCT
+        uint64_t value;
+        asm volatile ("mrs %0, cntvct_el0" : "=r" (value));
+        return value;
+#else
+        return static_cast<ticks> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    /** Waits for the preceding instructions to finish before reading the counter, use to close a measurement */
+    static ticks now_serialised()
+    {
+#if PURO_HAS_TSC
+        unsigned int aux;
+        return __rdtscp(&aux);
+#else
+        return now();
+#endif
+    }
+
+    /** Measure the tick rate against steady_clock, blocks for roughly the given time */
+    static double calibrate (int milliseconds = 20)
+    {
+        typedef std::chrono::steady_clock clock;
+
+        const auto t0 = clock::now();
+        const ticks c0 = now();
+
+        while (clock::now() - t0 < std::chrono::milliseconds (milliseconds))
+            ; // busy wait to keep the core clocked up
+
+        const ticks c1 = now_serialised();
+        const auto t1 = clock::now();
+
+        const double micros = std::chrono::duration<double, std::micro> (t1 - t0).count();
+        return static_cast<double> (c1 - c0) / micros;
+    }
+
+    /** Tick rate, and a tick count with its steady_clock time for converting ticks to steady_clock time */
+    struct calibration_result
+    {
+        double ticks_per_micro;
+        ticks origin_ticks;
+        double origin_micros;
+    };
+
+    static const calibration_result& calibration()
+    {
+        static const calibration_result result = []()
+        {
+            calibration_result r;
+            r.ticks_per_micro = calibrate();
+            r.origin_ticks = now();
+            r.origin_micros = std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now().time_since_epoch()).count();
+            return r;
+        }();
+
+        return result;
+    }
+
+    static double ticks_per_micro()
+    {
+        return calibration().ticks_per_micro;
+    }
+
+    /** Length of a tick interval in microseconds */
+    static double to_micros (ticks t)
+    {
+        return static_cast<double> (t) / ticks_per_micro();
+    }
+
+    /** Microseconds since the steady_clock epoch at a tick count */
+    static double to_steady_micros (ticks t)
+    {
+        const calibration_result& c = calibration();
+        return c.origin_micros + (static_cast<double> (t) - static_cast<double> (c.origin_ticks)) / c.ticks_per_micro;
+    }
+};
+
+
+#if PURO_PROFILE_USE_PERF
+
+/**
+ Hardware counters of the calling thread via perf_event_open, read as a single group.
+ Reading costs a system call, so expect around a microsecond of overhead per read.
+ If the counters can't be opened (check /proc/sys/kernel/perf_event_paranoid), all values read as zero.
+ */
+struct PerfCounters
+{
+    enum { instructions, cache_misses, branch_misses, num_counters };
+
+    struct values
+    {
+        uint64_t v [num_counters];
+    };
+
+    static const char* const* names()
+    {
+        static const char* const n [num_counters] = { "instructions", "cache_misses", "branch_misses" };
+        return n;
+    }
+
+    PerfCounters()
+    {
+        const uint64_t configs [num_counters] = {
+            PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        for (int i = 0; i < num_counters; ++i)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = (i == 0) ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            const int group = (i == 0) ? -1 : fds[0];
+            fds[i] = static_cast<int> (syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+        }
+
+        errorif(!is_open(), "perf_event_open failed");
+
+        if (is_open())
+        {
+            ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    ~PerfCounters()
+    {
+        for (int i = 0; i < num_counters; ++i)
+            if (fds[i] >= 0)
+                close(fds[i]);
+    }
+
+    bool is_open() const
+    {
+        for (int i = 0; i < num_counters; ++i)
+            if (fds[i] < 0)
+                return false;
+
+        return true;
+    }
+
+    values read_values() const
+    {
+        struct { uint64_t nr; uint64_t v [num_counters]; } group = {};
+
+        if (is_open())
+            if (::read(fds[0], &group, sizeof(group)) != sizeof(group))
+                group = {};
+
+        values result;
+        for (int i = 0; i < num_counters; ++i)
+            result.v[i] = group.v[i];
+
+        return result;
+    }
+
+    static values difference (const values& start, const values& end)
+    {
+        values result;
+        for (int i = 0; i < num_counters; ++i)
+            result.v[i] = end.v[i] - start.v[i];
+
+        return result;
+    }
+
+    int fds [num_counters];
+};
+
+#endif // PURO_PROFILE_USE_PERF
+
+
 
 #if PURO_USE_TRACE == 1
 
@@ -54,8 +389,9 @@ struct TraceFrame
     TraceEntry frame_start;
     std::vector<TraceEntry> entries;
     int entry_index;
+    int thread_id;
 
-    TraceFrame() : entry_index (0)
+    TraceFrame() : entry_index (0), thread_id (0)
     {
         entries.resize(256);
     }
@@ -65,6 +401,39 @@ struct TraceFrame
         frame_list.push_back(TraceFrame());
         current_frame = &frame_list.back();
         current_frame->frame_start = TraceEntry (nullptr);
+        current_frame->thread_id = get_thread_id();
+    }
+
+    /** Small sequential id for the calling thread, used as the tid of exported events */
+    static int get_thread_id()
+    {
+        static std::atomic<int> num_ids (0);
+        thread_local int id = num_ids.fetch_add(1);
+        return id;
+    }
+
+    /** Write every traced frame as a span, and the trace points inside it as instant events */
+    static void export_chrome_trace (const char* path)
+    {
+        ChromeTraceWriter writer (path);
+        errorif(!writer.is_open(), "could not open trace file");
+
+        std::vector<int> named_threads;
+
+        for (const auto& f : frame_list)
+        {
+            if (std::find (named_threads.begin(), named_threads.end(), f.thread_id) == named_threads.end())
+            {
+                writer.thread_name (f.thread_id, "trace thread");
+                named_threads.push_back (f.thread_id);
+            }
+
+            const auto frame_end = (f.entry_index > 0) ? f.entries[f.entry_index - 1].time : f.frame_start.time;
+            writer.complete ("frame", "trace", f.thread_id, f.frame_start.time, frame_end, 0);
+
+            for (int i=0; i<f.entry_index; ++i)
+                writer.instant (f.entries[i].name_function(), "trace", f.thread_id, f.entries[i].time);
+        }
     }
     
     static void done()
@@ -169,6 +538,7 @@ std::list<TraceFrame> TraceFrame::frame_list;
 
 #define TRACE_FRAME TraceFrame::begin()
 #define TRACE_DONE TraceFrame::done()
+#define TRACE_EXPORT(path) TraceFrame::export_chrome_trace(path)
 
 #define CONCAT(a, b) a ## b
 #define _TRACE(class_name, pretty_name) \
@@ -181,6 +551,7 @@ TraceFrame::add_entry(class_name::name);
 
 #define TRACE_FRAME
 #define TRACE_DONE
+#define TRACE_EXPORT(path)
 #define TRACE(a)
 
 #endif
@@ -190,56 +561,275 @@ TraceFrame::add_entry(class_name::name);
 
 #if PURO_USE_PROFILE == 1
 
-struct ProfileEntry
+#if PURO_PROFILE_USE_TSC
+
+struct ProfileClock
+{
+    typedef TscClock::ticks time_point;
+
+    static time_point now() { return TscClock::now(); }
+    static time_point now_end() { return TscClock::now_serialised(); }
+    static double micros_between (time_point start, time_point end) { return TscClock::to_micros(end - start); }
+    static double micros_since_epoch (time_point t) { return TscClock::to_steady_micros(t); }
+};
+
+#else
+
+struct ProfileClock
 {
     typedef std::chrono::steady_clock clock;
     typedef std::chrono::time_point<std::chrono::steady_clock> time_point;
+
+    static time_point now() { return clock::now(); }
+    static time_point now_end() { return clock::now(); }
+    static double micros_between (time_point start, time_point end) { return std::chrono::duration<double, std::micro> (end - start).count(); }
+    static double micros_since_epoch (time_point t) { return ChromeTraceWriter::to_micros(t); }
+};
+
+#endif
+
+#ifndef PURO_PROFILE_RING_SIZE
+    #define PURO_PROFILE_RING_SIZE 4096 // entries per thread, must be a power of two
+#endif
+
+#ifndef PURO_PROFILE_MAX_THREADS
+    #define PURO_PROFILE_MAX_THREADS 16
+#endif
+
+struct ProfileEntry
+{
+    typedef ProfileClock clock;
+    typedef ProfileClock::time_point time_point;
     
     float get_duration() const
     {
-        return std::chrono::duration<float, std::micro> (end_time - start_time).count();
+        return static_cast<float> (clock::micros_between(start_time, end_time));
     }
 
+    /** Frame spans are stored with negative depth, scoped entries with their nesting depth inside the frame */
+    bool is_frame() const { return depth < 0; }
+
     time_point start_time;
     time_point end_time;
+    int depth;
+    const char* name;
+
+#if PURO_PROFILE_USE_PERF
+    PerfCounters::values counters;
+#endif
 };
 
-struct ProfileFrame
+/**
+ Single-producer single-consumer ring of ProfileEntries.
+ Written only by the thread that owns it, read only by the collector.
+ If the collector falls behind, new entries are dropped and counted instead of overwriting unread ones.
+ */
+struct ProfileRing
 {
-    static ProfileFrame* current_frame;
-    static std::list<ProfileFrame> frame_list;
-    
+    static constexpr unsigned capacity = PURO_PROFILE_RING_SIZE;
+    static_assert((capacity & (capacity - 1)) == 0, "PURO_PROFILE_RING_SIZE should be a power of two");
+
+    ProfileRing() : write_index(0), read_index(0), num_dropped(0) {}
+
+    bool push(const ProfileEntry& e)
+    {
+        const unsigned w = write_index.load(std::memory_order_relaxed);
+        const unsigned r = read_index.load(std::memory_order_acquire);
+
+        if (w - r >= capacity)
+        {
+            num_dropped.store(num_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        entries[w & (capacity - 1)] = e;
+        write_index.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(ProfileEntry& e)
+    {
+        const unsigned r = read_index.load(std::memory_order_relaxed);
+        const unsigned w = write_index.load(std::memory_order_acquire);
+
+        if (r == w)
+            return false;
+
+        e = entries[r & (capacity - 1)];
+        read_index.store(r + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::array<ProfileEntry, capacity> entries;
+    std::atomic<unsigned> write_index;
+    std::atomic<unsigned> read_index;
+    std::atomic<unsigned> num_dropped;
+};
+
+/**
+ Profiling state of a single thread.
+ Allocated once when the thread registers itself and kept alive for the rest of the program,
+ so the frame path itself never allocates. Threads have to register before they profile anything,
+ entries from unregistered threads are dropped and counted in num_unregistered_dropped, which PROFILE_DONE reports.
+ */
+struct ProfileThread
+{
+    static std::atomic<ProfileThread*> threads[PURO_PROFILE_MAX_THREADS];
+    static std::atomic<int> num_threads;
+    static thread_local ProfileThread* local;
+    static std::atomic<unsigned> num_unregistered_dropped;
+
+    ProfileRing ring;
     ProfileEntry frame_span;
-    std::vector<ProfileEntry> entries;
-    int entry_index;
-    
-    ProfileFrame() : entry_index (0)
+    int thread_index = 0;
+    int depth = 0;
+
+#if PURO_PROFILE_USE_PERF
+    PerfCounters perf;
+    PerfCounters::values frame_counters_start;
+#endif
+
+    std::vector<ProfileEntry> collected; // only touched by the collector
+
+    /** Call from every profiled thread before processing starts, e.g. in prepareToPlay */
+    static ProfileThread& register_thread()
     {
-        entries.resize(256);
+        if (local != nullptr)
+            return *local;
+
+#if PURO_PROFILE_USE_TSC
+        TscClock::calibration(); // calibrate before the first frame
+#endif
+
+        local = new ProfileThread();
+
+        const int index = num_threads.fetch_add(1);
+        errorif(index >= PURO_PROFILE_MAX_THREADS, "too many profiled threads, increase PURO_PROFILE_MAX_THREADS");
+
+        // threads over the limit still write to their own ring, it is just never collected
+        if (index < PURO_PROFILE_MAX_THREADS)
+        {
+            local->thread_index = index;
+            local->collected.reserve(ProfileRing::capacity);
+            threads[index].store(local, std::memory_order_release);
+        }
+
+        return *local;
+    }
+
+    /** State of the calling thread, nullptr if it hasn't called register_thread(), in which case its entries are dropped */
+    static ProfileThread* get()
+    {
+        errorif(local == nullptr, "profiled thread not registered, call PROFILE_THREAD_REGISTER before processing");
+        return local;
+    }
+
+    /** Count an entry dropped because the calling thread isn't registered */
+    static void drop_unregistered()
+    {
+        num_unregistered_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static int get_num_threads()
+    {
+        const int n = num_threads.load(std::memory_order_acquire);
+        return n < PURO_PROFILE_MAX_THREADS ? n : PURO_PROFILE_MAX_THREADS;
     }
+};
+
+std::atomic<ProfileThread*> ProfileThread::threads[PURO_PROFILE_MAX_THREADS] = {};
+std::atomic<int> ProfileThread::num_threads (0);
+thread_local ProfileThread* ProfileThread::local = nullptr;
+std::atomic<unsigned> ProfileThread::num_unregistered_dropped (0);
+
+struct ProfileFrame
+{
+    static std::thread collector;
+    static std::atomic<bool> collecting;
     
     static void begin()
     {
-        frame_list.push_back(ProfileFrame());
-        current_frame = &frame_list.back();
-        current_frame->frame_span.start_time = ProfileEntry::clock::now();
+        ProfileThread* thread = ProfileThread::get();
+        if (thread == nullptr)
+            return;
+
+        ProfileThread& t = *thread;
+        t.depth = 0;
+#if PURO_PROFILE_USE_PERF
+        t.frame_counters_start = t.perf.read_values();
+#endif
+        t.frame_span.start_time = ProfileEntry::clock::now();
     }
     
     static void end()
     {
-        get_frame().frame_span.end_time = ProfileEntry::clock::now();
-    }
+        ProfileThread* thread = ProfileThread::get();
+        if (thread == nullptr)
+        {
+            ProfileThread::drop_unregistered();
+            return;
+        }
 
-    static ProfileFrame& get_frame()
-    {
-        return *current_frame;
+        ProfileThread& t = *thread;
+        t.frame_span.end_time = ProfileEntry::clock::now_end();
+        t.frame_span.depth = -1;
+        t.frame_span.name = "frame";
+#if PURO_PROFILE_USE_PERF
+        t.frame_span.counters = PerfCounters::difference(t.frame_counters_start, t.perf.read_values());
+#endif
+        t.ring.push(t.frame_span);
     }
     
     static void add_entry (const ProfileEntry& e)
     {
-        ProfileFrame& f = get_frame();
-        f.entries[f.entry_index] = e;
-        f.entry_index += 1;
+        if (ProfileThread* t = ProfileThread::get())
+            t->ring.push(e);
+        else
+            ProfileThread::drop_unregistered();
+    }
+
+    /** Move everything written so far from the thread rings to the collected entries. Not to be called from the audio thread. */
+    static void drain()
+    {
+        for (int i=0; i<ProfileThread::get_num_threads(); ++i)
+        {
+            ProfileThread* t = ProfileThread::threads[i].load(std::memory_order_acquire);
+
+            if (t == nullptr) // registration in progress
+                continue;
+
+            ProfileEntry e;
+            while (t->ring.pop(e))
+                t->collected.push_back(e);
+        }
+    }
+
+    /** Start a background thread that drains the thread rings periodically */
+    static void start_collecting (int interval_ms = 10)
+    {
+        if (collecting.exchange(true))
+            return;
+
+#if PURO_PROFILE_USE_TSC
+        TscClock::calibration();
+#endif
+
+        collector = std::thread ([interval_ms]()
+        {
+            while (collecting.load())
+            {
+                drain();
+                std::this_thread::sleep_for (std::chrono::milliseconds (interval_ms));
+            }
+        });
+    }
+
+    static void stop_collecting()
+    {
+        if (collecting.exchange(false))
+            collector.join();
+
+        drain();
     }
     
     struct Stats
@@ -252,26 +842,44 @@ struct ProfileFrame
     
     static void done()
     {
-        // for each frame
-            // calculate frame time
-            // calculate time spent in function
-        
+        stop_collecting();
+
         std::vector<float> frame_measurements;
         std::vector<float> func_measurements;
+        puro::latency_histogram<> frame_histogram;
+        unsigned num_dropped = 0;
+
+#if PURO_PROFILE_USE_PERF
+        double frame_counter_sums [PerfCounters::num_counters] = { 0 };
+        double func_counter_sums [PerfCounters::num_counters] = { 0 };
+#endif
         
         // populate measurement vectors
-        for (const auto& f : frame_list) // iterate frames
+        for (int i=0; i<ProfileThread::get_num_threads(); ++i)
         {
-            //float delta = std::chrono::duration<float, std::micro> (f.frame_span.end_time - f.frame_span.start_time).count();
-            float delta = f.frame_span.get_duration();
-            frame_measurements.push_back(delta);
+            ProfileThread* t = ProfileThread::threads[i].load(std::memory_order_acquire);
 
-            for (int i=0; i<f.entry_index; ++i)
+            if (t == nullptr)
+                continue;
+
+            for (const auto& e : t->collected)
             {
-                auto& e = f.entries[i];
-                float dur = e.get_duration();
-                func_measurements.push_back(dur);
+                if (e.is_frame())
+                {
+                    frame_measurements.push_back(e.get_duration());
+                    frame_histogram.record(static_cast<uint64_t> (e.get_duration() * 1000.0f));
+                }
+                else
+                    func_measurements.push_back(e.get_duration());
+
+#if PURO_PROFILE_USE_PERF
+                double* sums = e.is_frame() ? frame_counter_sums : func_counter_sums;
+                for (int c=0; c<PerfCounters::num_counters; ++c)
+                    sums[c] += static_cast<double> (e.counters.v[c]);
+#endif
             }
+
+            num_dropped += t->ring.num_dropped.load();
         }
         
         // calculate average frame time
@@ -281,13 +889,73 @@ struct ProfileFrame
         std::cout << "Frame time average:  " << frame_stats.average << "\n";
         std::cout << "Frame time deviance: " << frame_stats.deviation << "\n";
         std::cout << "Frame time minimum: " << frame_stats.minimum << "\n";
+        std::cout << "Frame time p50 / p99 / p99.9 / max: "
+                  << frame_histogram.percentile(0.5) / 1000.0f << " / "
+                  << frame_histogram.percentile(0.99) / 1000.0f << " / "
+                  << frame_histogram.percentile(0.999) / 1000.0f << " / "
+                  << frame_histogram.max() / 1000.0f << "\n";
         std::cout << "Function time average:  " << func_stats.average << "\n";
         std::cout << "Function time deviance: " << func_stats.deviation << "\n";
         std::cout << "Function time minimum: " << func_stats.minimum << "\n";
+
+#if PURO_PROFILE_USE_PERF
+        for (int c=0; c<PerfCounters::num_counters; ++c)
+        {
+            if (! frame_measurements.empty())
+                std::cout << "Frame " << PerfCounters::names()[c] << " average: " << frame_counter_sums[c] / frame_measurements.size() << "\n";
+            if (! func_measurements.empty())
+                std::cout << "Function " << PerfCounters::names()[c] << " average: " << func_counter_sums[c] / func_measurements.size() << "\n";
+        }
+#endif
+
+        if (num_dropped > 0)
+            std::cout << "Entries dropped: " << num_dropped << " (increase PURO_PROFILE_RING_SIZE or collect more often)\n";
+
+        const unsigned num_unregistered = ProfileThread::num_unregistered_dropped.load();
+        if (num_unregistered > 0)
+            std::cout << "Entries dropped from unregistered threads: " << num_unregistered << " (call PROFILE_THREAD_REGISTER on every profiled thread)\n";
+    }
+    
+    /**
+     Write all collected frames and scopes, one track per profiled thread.
+     Stops the collector, so call once profiling is over, e.g. right before PROFILE_DONE.
+     */
+    static void export_chrome_trace (const char* path)
+    {
+        stop_collecting();
+
+        ChromeTraceWriter writer (path);
+        errorif(!writer.is_open(), "could not open trace file");
+
+        for (int i=0; i<ProfileThread::get_num_threads(); ++i)
+        {
+            ProfileThread* t = ProfileThread::threads[i].load(std::memory_order_acquire);
+
+            if (t == nullptr)
+                continue;
+
+            writer.thread_name (t->thread_index, "profiled thread");
+
+            for (const auto& e : t->collected)
+            {
+                const double start = ProfileClock::micros_since_epoch(e.start_time);
+                const double duration = ProfileClock::micros_between(e.start_time, e.end_time);
+                const char* category = e.is_frame() ? "frame" : "profile";
+#if PURO_PROFILE_USE_PERF
+                writer.complete (e.name, category, t->thread_index, start, duration, e.depth,
+                                 PerfCounters::names(), e.counters.v, PerfCounters::num_counters);
+#else
+                writer.complete (e.name, category, t->thread_index, start, duration, e.depth);
+#endif
+            }
+        }
     }
     
     static Stats calculate_stats(std::vector<float>& vec)
     {
+        if (vec.empty())
+            return { 0, 0, 0, 0 };
+
         float average = 0;
         float minimum = 1e30;
         for (int i=0; i<vec.size(); ++i)
@@ -304,7 +972,8 @@ struct ProfileFrame
             float diff = vec[i] - average;
             variance += diff * diff;
         }
-        variance /= vec.size()-1;
+        if (vec.size() > 1)
+            variance /= vec.size()-1;
         
         return { average, variance, std::sqrt(variance), minimum };
     }
@@ -312,37 +981,71 @@ struct ProfileFrame
 
 struct ScopedProfileEntry
 {
-    typedef std::chrono::steady_clock clock;
-    typedef std::chrono::time_point<std::chrono::steady_clock> time_point;
+    typedef ProfileClock clock;
+    typedef ProfileClock::time_point time_point;
     
-    ScopedProfileEntry() : start_time(clock::now())
+    ScopedProfileEntry (const char* name = "") : thread(ProfileThread::get()), name(name)
     {
+        if (thread == nullptr)
+            return;
+
+        thread->depth += 1;
+#if PURO_PROFILE_USE_PERF
+        counters_start = thread->perf.read_values();
+#endif
+        start_time = clock::now();
     }
     
     ~ScopedProfileEntry()
     {
-        ProfileFrame::get_frame().add_entry({start_time, clock::now()});
+        if (thread == nullptr)
+        {
+            ProfileThread::drop_unregistered();
+            return;
+        }
+
+        ProfileEntry e;
+        e.end_time = clock::now_end();
+        e.start_time = start_time;
+        e.name = name;
+        thread->depth -= 1;
+        e.depth = thread->depth;
+#if PURO_PROFILE_USE_PERF
+        e.counters = PerfCounters::difference(counters_start, thread->perf.read_values());
+#endif
+        thread->ring.push(e);
     }
     
+    ProfileThread* thread;
+    const char* name;
     time_point start_time;
+#if PURO_PROFILE_USE_PERF
+    PerfCounters::values counters_start;
+#endif
 };
 
 
+std::thread ProfileFrame::collector;
+std::atomic<bool> ProfileFrame::collecting (false);
 
-ProfileFrame* ProfileFrame::current_frame = nullptr;
-std::list<ProfileFrame> ProfileFrame::frame_list;
-
+#define PROFILE_THREAD_REGISTER ProfileThread::register_thread()
+#define PROFILE_COLLECT ProfileFrame::start_collecting()
 #define PROFILE_FRAME_BEGIN ProfileFrame::begin()
 #define PROFILE_FRAME_END ProfileFrame::end()
 #define PROFILE_DONE ProfileFrame::done()
 
 #define CONCAT(a, b) a ## b
+#define PROFILE(a) ScopedProfileEntry CONCAT(a, _ScopedProfileEntry) (#a)
+#define PROFILE_EXPORT(path) ProfileFrame::export_chrome_trace(path)
 
 #else // NO PROFILE
 
+#define PROFILE_THREAD_REGISTER
+#define PROFILE_COLLECT
 #define PROFILE_FRAME_BEGIN
 #define PROFILE_FRAME_END
 #define PROFILE_DONE
+#define PROFILE_EXPORT(path)
 #define PROFILE(a)
 
 #endif
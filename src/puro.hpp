@@ -5,14 +5,22 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <cmath>
 #include <complex>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <random>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -21,19 +29,28 @@
 #include "../include/pffft.h"
 
 #include "math_scalar.hpp"
+#include "denormal.hpp"
+#include "worker_pool.hpp"
 #include "math_vector.hpp"
 #include "memory_source.hpp"
+#include "huge_page_allocator.hpp"
 #include "buffer.hpp"
 #include "ring_buffer.hpp"
 #include "sfinae.hpp"
 #include "buffer_operations.hpp"
+#include "expression.hpp"
 #include "spectrum.hpp"
 #include "aligned_pool.hpp"
 #include "node_stack.hpp"
 #include "alignment.hpp"
 #include "utility.hpp"
 #include "signal.hpp"
+#include "convolution.hpp"
 #include "envelope.hpp"
+#include "stft.hpp"
+#include "phase_vocoder.hpp"
+#include "spectral_grains.hpp"
+#include "latency.hpp"
 #include "interpolation.hpp"
 #include "panning.hpp"
 #include "prints.hpp"
@@ -25,4 +25,11 @@ template <int MaxNumChannels, typename T, typename Result>
 struct enable_if_buffer <dynamic_buffer<MaxNumChannels, T>, Result> { typedef Result type; };
 
 
+/** Used to keep spectra in the internal pffft order out of functions that expect ordered spectra */
+template <typename T>
+struct is_unordered_spectrum { static constexpr bool value = false; };
+
+template <int NumChannels, typename T>
+struct is_unordered_spectrum <unordered_spectrum<NumChannels, T>> { static constexpr bool value = true; };
+
 } // namespace puro
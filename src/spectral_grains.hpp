@@ -0,0 +1,303 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Bank of magnitude spectra captured from a signal, for spectral freezing and spectral granular synthesis.
+
+ Each captured frame is windowed with a periodic hann window, transformed, and its magnitudes are stored in half
+ precision, which halves the memory of long captures compared to float at a relative error of about 5e-4 (-66 dB).
+ Magnitudes are stored divided by sqrt(fft_size) and scaled back on read(). A full-scale sine then peaks at
+ sqrt(fft_size) / 4, far below the half precision maximum of 65504 at any practical size, while the bins of noise
+ keep the same level at every size instead of sinking into the subnormal range of half precision.
+ The bank holds up to capacity frames and overwrites the oldest ones once full. Frames are indexed from the oldest,
+ and can be read at fractional positions with linear interpolation between neighbouring frames.
+
+ Memory is allocated on construction, capturing and reading don't allocate.
+ */
+template <int NumChannels>
+struct spectral_frame_bank
+{
+    typedef buffer<NumChannels, float> buffer_type;
+
+    spectral_frame_bank (int fft_size, int capacity)
+    : fft_size(fft_size)
+    , num_bins(fft_size / 2 + 1)
+    , capacity(capacity)
+    , transform(fft_size)
+    , frame_memory(NumChannels, fft_size)
+    , magnitude_memory(NumChannels, fft_size / 2 + 1)
+    , window_memory(1, fft_size)
+    , frames(static_cast<size_t> (capacity) * NumChannels * (fft_size / 2 + 1))
+    , num_frames(0)
+    , write_index(0)
+    {
+        errorif(fft_size <= 0 || fft_size % 32 != 0, "fft size should be a positive multiple of 32");
+        errorif(capacity <= 0, "capacity should be positive");
+
+        buffer<1> window (fft_size, window_memory);
+        envelope_hann_fill(window, 0.0f, envelope_hann_get_increment<float>(fft_size, false));
+    }
+
+    spectral_frame_bank (const spectral_frame_bank&) = delete;
+    spectral_frame_bank& operator= (const spectral_frame_bank&) = delete;
+
+    /** Capture a single frame from the first fft_size samples of src */
+    template <typename BT>
+    void capture (const BT src)
+    {
+        errorif(src.length() < fft_size, "src should be at least fft size long");
+        errorif(src.num_channels() != NumChannels, "src channel count should equal NumChannels");
+
+        buffer_type frame (fft_size, frame_memory);
+        copy(frame, src.sub(0, fft_size));
+        multiply(frame, buffer<1> (fft_size, window_memory));
+        transform.rfft(frame);
+
+        buffer_type magnitudes (num_bins, magnitude_memory);
+        spectrum_magnitudes(magnitudes, frame);
+        multiply(magnitudes, 1.0f / magnitude_scale());
+
+        for (int ch = 0; ch < NumChannels; ++ch)
+            math::float_to_half(slot(write_index, ch), magnitudes.channel(ch), num_bins);
+
+        if (++write_index == capacity)
+            write_index = 0;
+
+        num_frames = math::min(num_frames + 1, capacity);
+    }
+
+    /** Capture all whole frames of src at the given hop size. Returns the number of frames captured. */
+    template <typename BT>
+    int capture (const BT src, int hop_size)
+    {
+        errorif(hop_size <= 0, "hop size should be positive");
+
+        int n = 0;
+        for (int start = 0; start + fft_size <= src.length(); start += hop_size, ++n)
+            capture(src.sub(start, fft_size));
+
+        return n;
+    }
+
+    /** Magnitudes at a fractional frame position, clipped to the captured frames. dst should be num_bins long. */
+    template <typename BT>
+    void read (BT dst, float position) const
+    {
+        errorif(dst.length() != num_bins, "dst length should equal the number of bins");
+        errorif(dst.num_channels() != NumChannels, "dst channel count should equal NumChannels");
+
+        if (num_frames == 0)
+        {
+            dst.clear();
+            return;
+        }
+
+        position = math::clip(position, 0.0f, static_cast<float> (num_frames - 1));
+        const int i0 = static_cast<int> (position);
+        const int i1 = math::min(i0 + 1, num_frames - 1);
+        const float frac = position - static_cast<float> (i0);
+        const float scale = magnitude_scale();
+
+        // the second frame is converted in chunks on the stack, so reading needs no scratch memory in the bank
+        constexpr int chunk_size = 64;
+        float next [chunk_size];
+
+        for (int ch = 0; ch < NumChannels; ++ch)
+        {
+            float* d = dst.channel(ch);
+            const float16* a = slot(frame_slot(i0), ch);
+            const float16* b = slot(frame_slot(i1), ch);
+
+            math::half_to_float(d, a, num_bins);
+
+            for (int start = 0; start < num_bins; start += chunk_size)
+            {
+                const int n = math::min(chunk_size, num_bins - start);
+                math::half_to_float(next, b + start, n);
+
+                for (int k = 0; k < n; ++k)
+                    d[start + k] = scale * (d[start + k] + frac * (next[k] - d[start + k]));
+            }
+        }
+    }
+
+    void clear()
+    {
+        num_frames = 0;
+        write_index = 0;
+    }
+
+    int size() const { return num_frames; }
+
+    const int fft_size;
+    const int num_bins;
+    const int capacity;
+
+private:
+
+    float magnitude_scale() const { return std::sqrt(static_cast<float> (fft_size)); }
+
+    /** Slot of the frame at index, counted from the oldest */
+    int frame_slot (int index) const
+    {
+        int s = write_index - num_frames + index;
+        return (s < 0) ? s + capacity : s;
+    }
+
+    float16* slot (int s, int ch) { return &frames[(static_cast<size_t> (s) * NumChannels + ch) * num_bins]; }
+    const float16* slot (int s, int ch) const { return &frames[(static_cast<size_t> (s) * NumChannels + ch) * num_bins]; }
+
+    math::fft transform;
+
+    heap_block<float, math::allocator<float>> frame_memory;
+    heap_block<float, math::allocator<float>> magnitude_memory;
+    heap_block<float, math::allocator<float>> window_memory;
+    std::vector<float16> frames;
+
+    int num_frames;
+    int write_index;
+};
+
+/**
+ Resynthesises grains from a spectral_frame_bank with random phases.
+
+ Every hop_size output samples a grain is made from the magnitudes at the given frame position, jittered by up to
+ spread frames, with uniformly random phases. The grain is transformed back, windowed with a hann window and
+ overlap-added to the output. Holding the position still freezes the sound, moving it scans through the capture
+ at any speed. The window is scaled so that noise-like material keeps the level it was captured at.
+
+ Memory is allocated on construction. process() doesn't allocate.
+ */
+template <int NumChannels, math::accuracy Accuracy = math::accuracy::fast>
+struct spectral_grain_generator
+{
+    typedef buffer<NumChannels, float> buffer_type;
+
+    spectral_grain_generator (int fft_size, int hop_size, unsigned int seed = 0)
+    : fft_size(fft_size)
+    , hop_size(hop_size)
+    , num_bins(fft_size / 2 + 1)
+    , transform(fft_size)
+    , frame_memory(NumChannels, fft_size)
+    , spectral_memory(2 * NumChannels, fft_size / 2 + 1)
+    , window_memory(1, fft_size)
+    , output_memory(NumChannels, fft_size + hop_size)
+    , output(fft_size + hop_size, output_memory)
+    , random(seed)
+    , hop_position(0)
+    {
+        errorif(fft_size <= 0 || fft_size % 32 != 0, "fft size should be a positive multiple of 32");
+        errorif(hop_size <= 0 || hop_size > fft_size, "hop size should be between 1 and fft size");
+
+        float* window = window_memory.ptrs[0];
+        buffer<1> window_buffer (fft_size, window_memory);
+        envelope_hann_fill(window_buffer, 0.0f, envelope_hann_get_increment<float>(fft_size, false));
+
+        float energy = 0;
+        for (int i = 0; i < fft_size; ++i)
+            energy += window[i] * window[i];
+
+        // grains are uncorrelated, so their powers add: scale by the overlapping squared windows and the captured
+        // window energy, with the 1/N of the inverse transform
+        for (int i = 0; i < hop_size; ++i)
+        {
+            float sum = 0;
+            for (int j = i; j < fft_size; j += hop_size)
+                sum += window[j] * window[j];
+
+            const float scale = (sum > 0) ? 1.0f / std::sqrt(sum * energy * static_cast<float> (fft_size)) : 0.0f;
+
+            for (int j = i; j < fft_size; j += hop_size)
+                window[j] *= scale;
+        }
+
+        reset();
+    }
+
+    spectral_grain_generator (const spectral_grain_generator&) = delete;
+    spectral_grain_generator& operator= (const spectral_grain_generator&) = delete;
+
+    void reset()
+    {
+        for (int ch = 0; ch < NumChannels; ++ch)
+            math::clear(output.channel(ch), output.length());
+
+        output.index = 0;
+        hop_position = 0;
+    }
+
+    /** Fill dst with grains from the bank around frame position. Spread is the maximum random offset in frames. */
+    template <typename BT>
+    void process (BT dst, const spectral_frame_bank<NumChannels>& bank, float position, float spread = 0.0f)
+    {
+        errorif(dst.num_channels() != NumChannels, "dst channel count should equal NumChannels");
+        errorif(bank.fft_size != fft_size, "bank fft size should equal the generator fft size");
+
+        int written = 0;
+        while (written < dst.length())
+        {
+            if (hop_position == 0)
+                process_grain(bank, position + spread * uniform(random));
+
+            const int n = math::min(dst.length() - written, hop_size - hop_position);
+
+            ring_buffer_copy_to_buffer(dst.sub(written, n), output, 0);
+            ring_buffer_clear(output, 0, n);
+            output = ring_buffer_advance_index(output, n);
+
+            written += n;
+            hop_position += n;
+            if (hop_position == hop_size)
+                hop_position = 0;
+        }
+    }
+
+    const int fft_size;
+    const int hop_size;
+    const int num_bins;
+
+private:
+
+    void process_grain (const spectral_frame_bank<NumChannels>& bank, float position)
+    {
+        buffer_type frame (fft_size, frame_memory);
+        buffer_type magnitudes (num_bins, &spectral_memory.ptrs[0]);
+        buffer_type phases (num_bins, &spectral_memory.ptrs[NumChannels]);
+
+        bank.read(magnitudes, position);
+
+        for (int ch = 0; ch < NumChannels; ++ch)
+        {
+            float* p = phases.channel(ch);
+            for (int k = 0; k < num_bins; ++k)
+                p[k] = static_cast<float> (math::pi) * uniform(random);
+
+            // DC and Nyquist are real
+            p[0] = 0;
+            p[num_bins - 1] = 0;
+        }
+
+        spectrum_from_polar<Accuracy>(frame, magnitudes, phases);
+        transform.irfft(frame, false);
+        multiply(frame, buffer<1> (fft_size, window_memory));
+
+        ring_buffer_add_from_buffer(output, frame, 0);
+    }
+
+    math::fft transform;
+
+    heap_block<float, math::allocator<float>> frame_memory;
+    heap_block<float, math::allocator<float>> spectral_memory;
+    heap_block<float, math::allocator<float>> window_memory;
+    heap_block<float, math::allocator<float>> output_memory;
+
+    ring_buffer<NumChannels> output;
+
+    std::minstd_rand random;
+    std::uniform_real_distribution<float> uniform { -1.0f, 1.0f };
+
+    int hop_position;
+};
+
+} // namespace puro
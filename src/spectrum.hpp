@@ -5,6 +5,8 @@ namespace puro {
 template <typename BT1, typename BT2>
 inline void spectrum_power(BT1 dstReal, BT2 srcComplex)
 {
+    static_assert(! is_unordered_spectrum<BT2>::value, "expects spectra in the ordered format of math::fft");
+
     errorif(dstReal.num_channels() != srcComplex.num_channels(), "channel configs not identicalt");
     errorif(dstReal.length() != (srcComplex.length() / 2 + 1), "buffer lengths are not compatible");
 
@@ -28,6 +30,8 @@ inline void spectrum_power(BT1 dstReal, BT2 srcComplex)
 template <typename BT1, typename BT2>
 void spectrum_magnitudes(BT1 dstReal, BT2 srcComplex)
 {
+    static_assert(! is_unordered_spectrum<BT2>::value, "expects spectra in the ordered format of math::fft");
+
     errorif(dstReal.num_channels() != srcComplex.num_channels(), "channel configs not identicalt");
     errorif(dstReal.length() != (srcComplex.length() / 2 + 1), "buffer lengths are not compatible");
     
@@ -41,16 +45,16 @@ void spectrum_magnitudes(BT1 dstReal, BT2 srcComplex)
         dst[0] = fabs(src[0]);
         dst[dstReal.length() - 1] = fabs(src[1]);
 
-        for (int si=2, di=1; si < srcComplex.length(); si+=2, ++di)
-        {
-            dst[di] = std::sqrt(src[si]*src[si] + src[si+1] * src[si+1]);
-        }
+        math::complex_magnitudes(&dst[1], &src[2], dstReal.length() - 2);
     }
 }
     
-template <typename BT1, typename BT2>
+/** Phases of the bins, math::accuracy::fast uses a vectorised atan2 approximation */
+template <math::accuracy Accuracy = math::accuracy::exact, typename BT1, typename BT2>
 inline void spectrum_phases(BT1 dstReal, BT2 srcComplex)
 {
+    static_assert(! is_unordered_spectrum<BT2>::value, "expects spectra in the ordered format of math::fft");
+
     errorif(dstReal.num_channels() != srcComplex.num_channels(), "channel configs not identicalt");
     errorif(dstReal.length() != (srcComplex.length() / 2 + 1), "buffer lengths are not compatible");
 
@@ -64,18 +68,16 @@ inline void spectrum_phases(BT1 dstReal, BT2 srcComplex)
         dst[0] = ( (src[0] >= 0) ? 0 : math::pi);
         dst[dstReal.length() - 1] = ( (src[1] >= 0) ? 0 : math::pi);
 
-        for (int si=2, di=1; si < srcComplex.length(); si+=2, ++di)
-        {
-            const T re = src[si];
-            const T im = src[si+1];
-            dst[di] = std::atan2(im, re);
-        }
+        math::complex_phases<Accuracy>(&dst[1], &src[2], dstReal.length() - 2);
     }
 }
 
-template <typename BT1, typename BT2, typename BT3>
+/** Spectrum from magnitudes and phases, math::accuracy::fast uses a vectorised sincos approximation */
+template <math::accuracy Accuracy = math::accuracy::exact, typename BT1, typename BT2, typename BT3>
 inline void spectrum_from_polar(BT1 dstComplex, BT2 magnitudesReal, BT3 phasesReal)
 {
+    static_assert(! is_unordered_spectrum<BT1>::value, "expects spectra in the ordered format of math::fft");
+
     errorif(magnitudesReal.length() != phasesReal.length(), "magnitudes and phases length differs");
     errorif(magnitudesReal.length() != dstComplex.length()/2+1, "dst and magnitudes lengths incompatible");
     
@@ -91,17 +93,15 @@ inline void spectrum_from_polar(BT1 dstComplex, BT2 magnitudesReal, BT3 phasesRe
         dst[0] = (psrc[0] == 0) ? msrc[0] : -msrc[0];
         dst[1] = (psrc[nq] == 0) ? msrc[nq] : -msrc[nq];
 
-        for (int di=2, si=1; di < dstComplex.length(); di += 2, ++si)
-        {
-            dst[di] = std::cos(psrc[si]) * msrc[si];
-            dst[di + 1] = std::sin(psrc[si]) * msrc[si];
-        }
+        math::complex_from_polar<Accuracy>(&dst[2], &msrc[1], &psrc[1], nq - 1);
     }
 }
     
 template <typename BT1, typename BT2>
 inline void spectrum_linphase_from_magnitudes(BT1 dstComplex, BT2 magnitudesReal)
 {
+    static_assert(! is_unordered_spectrum<BT1>::value, "expects spectra in the ordered format of math::fft");
+
     errorif(magnitudesReal.length() != dstComplex.length()/2+1, "dst and magnitudes lengths incompatible");
     
     typedef typename BT1::value_type T;
@@ -126,6 +126,8 @@ inline void spectrum_linphase_from_magnitudes(BT1 dstComplex, BT2 magnitudesReal
 template <typename BT1, typename BT2>
 inline void spectrum_substract(BT1 dst, const BT2 src)
 {
+    static_assert(! (is_unordered_spectrum<BT1>::value || is_unordered_spectrum<BT2>::value), "expects spectra in the ordered format of math::fft");
+
     typedef typename BT1::value_type T;
 
     for (int ch=0; ch<dst.num_channels(); ++ch)
@@ -137,6 +139,8 @@ inline void spectrum_substract(BT1 dst, const BT2 src)
 template <typename BT1, typename BT2>
 inline void spectrum_multiply(BT1 dst, const BT2 src)
 {
+    static_assert(! (is_unordered_spectrum<BT1>::value || is_unordered_spectrum<BT2>::value), "expects spectra in the ordered format of math::fft");
+
     errorif (dst.length() != src.length(), "lengths don't match");
     
     typedef typename BT1::value_type T;
@@ -176,6 +180,8 @@ inline void spectrum_multiply(BT1 dst, const BT2 src)
 template <typename BT1, typename BT2, typename BT3>
 inline void spectrum_multiply(BT1 dst, const BT2 src1, const BT3 src2)
 {
+    static_assert(! (is_unordered_spectrum<BT1>::value || is_unordered_spectrum<BT2>::value || is_unordered_spectrum<BT3>::value), "expects spectra in the ordered format of math::fft");
+
     typedef typename BT1::value_type T;
 
     errorif (dst.length() != src1.length(), "lengths don't match");
@@ -0,0 +1,164 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Streaming short-time Fourier transform analysis and resynthesis.
+
+ Input is collected to a ring buffer, and every hop_size samples the latest fft_size samples are windowed,
+ transformed, handed to the spectral callback, transformed back, windowed again and overlap-added to the output
+ ring buffer. The callback receives the spectra of all channels as a buffer in the ordered format of math::fft and
+ modifies them in place, so the functions in spectrum.hpp can be used on them directly.
+
+ The synthesis window is derived from the analysis window so that an unmodified spectrum is reconstructed exactly
+ for any window that covers every sample. The latency is fft_size - 1 samples regardless of the block size, and
+ frames are processed at the exact sample the hop is completed, so blocks can have any length.
+ All memory is allocated on construction.
+ */
+template <int NumChannels>
+struct stft_processor
+{
+    typedef buffer<NumChannels, float> buffer_type;
+
+    stft_processor (int fft_size, int hop_size)
+    : fft_size(fft_size)
+    , hop_size(hop_size)
+    , transform(fft_size)
+    , input_memory(NumChannels, fft_size)
+    , output_memory(NumChannels, fft_size + hop_size)
+    , frame_memory(NumChannels, fft_size)
+    , window_memory(2, fft_size)
+    , input(fft_size, input_memory)
+    , output(fft_size + hop_size, output_memory)
+    , frame(fft_size, frame_memory)
+    , hop_position(0)
+    {
+        errorif(fft_size <= 0 || fft_size % 32 != 0, "fft size should be a positive multiple of 32");
+        errorif(hop_size <= 0 || hop_size > fft_size, "hop size should be between 1 and fft size");
+
+        // periodic hann
+        buffer<1> window (fft_size, window_memory);
+        envelope_hann_fill(window, 0.0f, envelope_hann_get_increment<float>(fft_size, false));
+        set_window(window);
+
+        reset();
+    }
+
+    stft_processor (const stft_processor&) = delete;
+    stft_processor& operator= (const stft_processor&) = delete;
+
+    /** Set the analysis window, and derive the synthesis window from it */
+    template <typename BT>
+    void set_window (BT window)
+    {
+        errorif(window.length() != fft_size, "window length should equal fft size");
+
+        float* analysis = window_memory.ptrs[0];
+        float* synthesis = window_memory.ptrs[1];
+
+        math::copy(analysis, window.channel(0), fft_size);
+
+        // synthesis = analysis / (sum of the squared windows overlapping each sample), with the 1/N of the inverse transform
+        for (int i = 0; i < hop_size; ++i)
+        {
+            float sum = 0;
+            for (int j = i; j < fft_size; j += hop_size)
+                sum += analysis[j] * analysis[j];
+
+            errorif(sum <= 0, "window doesn't cover every sample with the given hop size");
+
+            for (int j = i; j < fft_size; j += hop_size)
+                synthesis[j] = analysis[j] / (sum * static_cast<float> (fft_size));
+        }
+    }
+
+    /** Clear the input and output histories */
+    void reset()
+    {
+        input.index = 0;
+        output.index = 0;
+        hop_position = 0;
+
+        for (int ch = 0; ch < NumChannels; ++ch)
+        {
+            math::clear(input.channel(ch), input.length());
+            math::clear(output.channel(ch), output.length());
+        }
+    }
+
+    /**
+     Process a block of any length. The callback is called as callback(buffer_type spectrum) for every frame that is
+     completed within the block. dst and src can be the same buffer.
+     */
+    template <typename BT1, typename BT2, typename Callback>
+    void process (BT1 dst, const BT2 src, Callback&& callback)
+    {
+        errorif(dst.length() != src.length(), "dst and src lengths don't match");
+        errorif(dst.num_channels() != NumChannels || src.num_channels() != NumChannels, "channel configs not identical");
+
+        int position = 0;
+        while (position < src.length())
+        {
+            const int n = math::min(src.length() - position, hop_size - hop_position);
+
+            ring_buffer_copy_from_buffer(input, src.sub(position, n), 0);
+            input = ring_buffer_advance_index(input, n);
+            hop_position += n;
+
+            // the first sample of the frame is output with the last sample of this chunk
+            if (hop_position == hop_size)
+            {
+                process_frame(callback, n - 1);
+                hop_position = 0;
+            }
+
+            ring_buffer_copy_to_buffer(dst.sub(position, n), output, 0);
+            ring_buffer_clear(output, 0, n);
+            output = ring_buffer_advance_index(output, n);
+
+            position += n;
+        }
+    }
+
+    int latency() const { return fft_size - 1; }
+
+    const int fft_size;
+    const int hop_size;
+
+private:
+
+    template <typename Callback>
+    void process_frame (Callback& callback, int output_offset)
+    {
+        // input index points to the oldest sample, which is the start of the frame
+        ring_buffer_copy_to_buffer(frame, input, 0);
+
+        buffer<1> analysis_window (fft_size, &window_memory.ptrs[0]);
+        buffer<1> synthesis_window (fft_size, &window_memory.ptrs[1]);
+
+        multiply(frame, analysis_window);
+        transform.rfft(frame);
+
+        callback(frame);
+
+        transform.irfft(frame, false);
+        multiply(frame, synthesis_window);
+
+        ring_buffer_add_from_buffer(output, frame, output_offset);
+    }
+
+    math::fft transform;
+
+    heap_block<float, math::allocator<float>> input_memory;
+    heap_block<float, math::allocator<float>> output_memory;
+    heap_block<float, math::allocator<float>> frame_memory;
+    heap_block<float, math::allocator<float>> window_memory;
+
+    ring_buffer<NumChannels> input;
+    ring_buffer<NumChannels> output;
+    buffer_type frame;
+
+    int hop_position;
+};
+
+} // namespace puro
@@ -0,0 +1,115 @@
+#pragma once
+
+namespace puro {
+
+/**
+ Small pool of worker threads for data-parallel loops, such as transforming the channels of a buffer at once.
+
+ run() hands out task indices through an atomic counter and the calling thread takes part in the work, so a pool
+ of N threads processes with N + 1 threads. run() returns once all tasks are done and every worker has seen the
+ batch, after which the task function is not referenced anymore. Nothing is allocated in run(), the only lock is
+ the short one to wake up the workers. Threads are created in the constructor and joined in the destructor.
+ Workers run with a denormal_guard in place.
+ */
+struct worker_pool
+{
+    worker_pool (int num_threads)
+    : generation(0)
+    , running(true)
+    , task_function(nullptr)
+    , task_context(nullptr)
+    , num_tasks(0)
+    , next_task(0)
+    , num_workers_done(0)
+    {
+        for (int i = 0; i < num_threads; ++i)
+            threads.emplace_back([this]() { worker_loop(); });
+    }
+
+    ~worker_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            running = false;
+        }
+
+        condition.notify_all();
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    worker_pool (const worker_pool&) = delete;
+    worker_pool& operator= (const worker_pool&) = delete;
+
+    int num_threads() const { return static_cast<int> (threads.size()); }
+
+    /** Call f(index) for every index in [0, n), spread over the workers and the calling thread */
+    template <typename Function>
+    void run (int n, Function& f)
+    {
+        task_function = [](void* context, int index) { (*static_cast<Function*> (context))(index); };
+        task_context = &f;
+        num_tasks = n;
+        next_task.store(0, std::memory_order_relaxed);
+        num_workers_done.store(0, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            ++generation;
+        }
+
+        condition.notify_all();
+
+        work();
+
+        while (num_workers_done.load(std::memory_order_acquire) < num_threads())
+            std::this_thread::yield();
+    }
+
+private:
+
+    void work()
+    {
+        int index;
+        while ((index = next_task.fetch_add(1, std::memory_order_relaxed)) < num_tasks)
+            task_function(task_context, index);
+    }
+
+    void worker_loop()
+    {
+        denormal_guard guard;
+        uint64_t seen = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock (mutex);
+                condition.wait(lock, [&]() { return ! running || generation != seen; });
+
+                if (! running)
+                    return;
+
+                seen = generation;
+            }
+
+            work();
+            num_workers_done.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint64_t generation;
+    bool running;
+
+    void (*task_function)(void*, int);
+    void* task_context;
+    int num_tasks;
+
+    std::atomic<int> next_task;
+    std::atomic<int> num_workers_done;
+};
+
+} // namespace puro
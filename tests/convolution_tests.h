@@ -0,0 +1,117 @@
+#pragma once
+
+#include "puro.hpp"
+
+/**
+ Missed deadlines in the non_uniform_convolver tail. The worker of the only tail stage is stalled by holding its
+ mutex for three stage blocks while the audio thread keeps going. Every stage block of the output should then be
+ either the full convolution or the head alone, with the tail dropped, and the output should return to the full
+ convolution once the worker has caught up. A shifted or corrupted tail matches neither.
+ */
+
+constexpr int block_size = 64;
+constexpr int growth = 4;
+constexpr int stage_block_size = growth * block_size;
+constexpr int ir_length = 8 * stage_block_size; // a single tail stage
+constexpr int num_blocks = 64 * growth;
+
+bool segment_matches (const std::vector<float>& a, const std::vector<float>& b, int start, int length)
+{
+    for (int i = start; i < start + length; ++i)
+        if (std::abs(a[i] - b[i]) > 1e-4f)
+            return false;
+    return true;
+}
+
+int main()
+{
+    int failures = 0;
+
+    std::mt19937 generator (1);
+    std::uniform_real_distribution<float> distribution (-1.0f, 1.0f);
+
+    std::vector<float> ir_data (ir_length);
+    for (int i = 0; i < ir_length; ++i)
+        ir_data[i] = distribution(generator) * std::exp(-i / 1000.0f);
+
+    std::vector<float> input (num_blocks * block_size);
+    for (auto& x : input)
+        x = distribution(generator);
+
+    float* ir_ptrs[1] = { ir_data.data() };
+    puro::buffer<1> ir (ir_length, ir_ptrs);
+
+    // reference outputs of the full convolution processed inline, and of the head alone
+    std::vector<float> full (input.size());
+    std::vector<float> head_only (input.size());
+    std::vector<float> output (input.size());
+    {
+        puro::non_uniform_convolver<1> reference (block_size, ir, growth, false);
+        puro::uniform_convolver<1> head (block_size, ir.sub(0, 2 * stage_block_size));
+
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            float* src[1] = { &input[b * block_size] };
+            float* dst[1] = { &full[b * block_size] };
+            float* head_dst[1] = { &head_only[b * block_size] };
+
+            reference.process(puro::buffer<1> (block_size, dst), puro::buffer<1> (block_size, src));
+            head.process(puro::buffer<1> (block_size, head_dst), puro::buffer<1> (block_size, src));
+        }
+    }
+
+    std::cout << "Worker stalled for three stage blocks" << std::endl;
+    {
+        puro::non_uniform_convolver<1> convolver (block_size, ir, growth, true);
+        auto& stage = *convolver.tail[0];
+
+        const int stall_begin = 16 * growth;
+        const int stall_end = stall_begin + 3 * growth;
+
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            if (b == stall_begin)
+                stage.mutex.lock();
+            if (b == stall_end)
+                stage.mutex.unlock();
+
+            float* src[1] = { &input[b * block_size] };
+            float* dst[1] = { &output[b * block_size] };
+            convolver.process(puro::buffer<1> (block_size, dst), puro::buffer<1> (block_size, src));
+
+            // outside the stall, give the worker a comfortable real-time margin
+            if (b < stall_begin || b >= stall_end)
+                std::this_thread::sleep_for(std::chrono::microseconds (200));
+        }
+
+        int num_full = 0;
+        int num_dropped = 0;
+        bool recovered = true;
+
+        for (int start = 0; start < num_blocks * block_size; start += stage_block_size)
+        {
+            const bool is_full = segment_matches(output, full, start, stage_block_size);
+            const bool is_dropped = ! is_full && segment_matches(output, head_only, start, stage_block_size);
+
+            num_full += is_full;
+            num_dropped += is_dropped;
+
+            if (! is_full && ! is_dropped)
+                std::cout << "stage block " << start / stage_block_size << " matches neither" << std::endl;
+
+            if (start >= (stall_end + 4 * growth) * block_size)
+                recovered = recovered && is_full;
+        }
+
+        std::cout << "full: " << num_full << ", dropped: " << num_dropped
+                  << ", counted misses: " << convolver.num_missed_deadlines()
+                  << ", recovered: " << recovered << std::endl;
+
+        failures += (num_full + num_dropped != num_blocks / growth);
+        failures += (num_dropped == 0) || (num_dropped != convolver.num_missed_deadlines());
+        failures += ! recovered;
+    }
+
+    std::cout << (failures == 0 ? "All passed" : "FAILED") << std::endl;
+    return failures;
+}
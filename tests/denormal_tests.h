@@ -0,0 +1,115 @@
+#pragma once
+
+#include "puro.hpp"
+
+/**
+ Throughput of a one-pole lowpass on denormal-heavy input: a quiet tail of subnormal samples, as left by decaying
+ grains and feedback paths. Runs the plain kernel, the same kernel under a denormal_guard, the denormal-safe kernel,
+ and the plain kernel with the input and the filter state flushed at block entry. Flushing the input alone isn't
+ enough: the state gets stuck at a subnormal value, because coeff * state rounds to zero there.
+ Also checks that the guard sets and restores the mode.
+ */
+
+constexpr int block_size = 256;
+constexpr int num_blocks = 4096;
+
+template <typename Function>
+double ns_per_sample(Function&& process_block)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    for (int block = 0; block < num_blocks; ++block)
+        process_block();
+
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano> (t1 - t0).count() / (static_cast<double> (block_size) * num_blocks);
+}
+
+int count_subnormals(const float* buf, int n)
+{
+    int count = 0;
+    for (int i = 0; i < n; ++i)
+        count += (buf[i] != 0 && std::abs(buf[i]) < std::numeric_limits<float>::min()) ? 1 : 0;
+    return count;
+}
+
+int main()
+{
+    int failures = 0;
+
+    const float subnormal = std::numeric_limits<float>::min() / 64;
+    const float coeff = 0.01f;
+
+    std::vector<float> tail_data (block_size);
+    std::vector<float> output_data (block_size);
+    puro::buffer<1> tail (block_size, tail_data);
+    puro::buffer<1> output (block_size, output_data);
+
+    for (int i = 0; i < block_size; ++i)
+        tail.channel(0)[i] = subnormal * static_cast<float> (1 + (i % 7));
+
+    std::cout << "Guard sets and restores the mode" << std::endl;
+    {
+        const bool before = puro::denormal_guard::is_enabled();
+        {
+            puro::denormal_guard guard;
+            std::cout << "enabled in scope: " << puro::denormal_guard::is_enabled() << std::endl;
+        }
+        const bool after = puro::denormal_guard::is_enabled();
+        std::cout << "restored: " << (before == after) << std::endl;
+
+        failures += (before != after);
+#if PURO_SSE
+        failures += before;
+#endif
+    }
+
+    std::cout << "flush_denormals" << std::endl;
+    {
+        std::vector<float> flushed (tail_data);
+        flushed[3] = 0.5f;
+        puro::math::flush_denormals(flushed.data(), block_size);
+
+        std::cout << "subnormals left: " << count_subnormals(flushed.data(), block_size) << ", normal kept: " << flushed[3] << std::endl;
+        failures += (count_subnormals(flushed.data(), block_size) != 0) || (flushed[3] != 0.5f);
+    }
+
+    std::cout << "One-pole lowpass on subnormal input, ns per sample" << std::endl;
+    {
+        float state = subnormal;
+        const double plain = ns_per_sample([&]() { puro::one_pole(output, tail, coeff, &state); });
+        const int plain_subnormals = count_subnormals(output.channel(0), block_size);
+
+        state = subnormal;
+        const double guarded = ns_per_sample([&]()
+        {
+            puro::denormal_guard guard;
+            puro::one_pole(output, tail, coeff, &state);
+        });
+
+        state = subnormal;
+        const double safe = ns_per_sample([&]() { puro::one_pole<true>(output, tail, coeff, &state); });
+        const int safe_subnormals = count_subnormals(output.channel(0), block_size);
+
+        std::vector<float> flushed_data (tail_data);
+        puro::buffer<1> flushed (block_size, flushed_data);
+        state = subnormal;
+        const double flushed_input = ns_per_sample([&]()
+        {
+            puro::flush_denormals(flushed);
+            state = puro::math::flush_denormal(state);
+            puro::one_pole(output, flushed, coeff, &state);
+        });
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "plain:            " << plain << " (" << plain_subnormals << " subnormal outputs per block)" << std::endl
+                  << "denormal_guard:   " << guarded << "  speedup " << plain / guarded << std::endl
+                  << "denormal-safe:    " << safe << "  speedup " << plain / safe << std::endl
+                  << "flushed at entry: " << flushed_input << "  speedup " << plain / flushed_input << std::endl;
+
+        failures += (safe_subnormals != 0);
+    }
+
+    std::cout << (failures == 0 ? "All passed" : "FAILED") << std::endl;
+    return failures;
+}